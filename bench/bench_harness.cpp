@@ -0,0 +1,66 @@
+#include "bench_harness.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static uint64_t gAllocations = 0;
+
+void* operator new(std::size_t size) {
+  gAllocations++;
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+uint64_t BenchAllocationCount() {
+  return gAllocations;
+}
+
+BenchResult RunBench(std::string_view name, const BenchTransaction& txn,
+                     std::chrono::milliseconds duration) {
+  using Clock = std::chrono::steady_clock;
+
+  // Warm up so lazily grown buffers don't count against the steady state.
+  for (int i = 0; i < 64; ++i) {
+    txn();
+  }
+
+  BenchResult result;
+  const uint64_t allocationsBefore = gAllocations;
+  const auto start = Clock::now();
+  const auto deadline = start + duration;
+
+  // Check the clock in batches, since a transaction can be cheaper than reading it. The batch
+  // grows until it takes about a millisecond.
+  unsigned batch = 1;
+  for (auto now = start; now < deadline;) {
+    for (unsigned i = 0; i < batch; ++i) {
+      result.Bytes += txn();
+    }
+    result.Transactions += batch;
+    const auto batchStart = now;
+    now = Clock::now();
+    if (now - batchStart < std::chrono::milliseconds(1) && batch < 4096) {
+      batch *= 2;
+    }
+  }
+
+  result.Elapsed = Clock::now() - start;
+  result.Allocations = gAllocations - allocationsBefore;
+
+  const double seconds = std::chrono::duration<double>(result.Elapsed).count();
+  std::printf("%-12.*s %12.0f txn/s %14.0f bytes/s %8.3f allocs/txn\n", (int)name.size(),
+              name.data(), result.Transactions / seconds, result.Bytes / seconds,
+              static_cast<double>(result.Allocations) / result.Transactions);
+  return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// Allocation counter fed by the operator new replacement in bench_harness.cpp.
+uint64_t BenchAllocationCount();
+
+struct BenchResult {
+  uint64_t Transactions{0};
+  uint64_t Bytes{0};
+  uint64_t Allocations{0};
+  std::chrono::nanoseconds Elapsed{0};
+};
+
+// A single synthetic transaction. Returns the number of payload bytes it moved.
+using BenchTransaction = std::function<uint32_t()>;
+
+// Run `txn` repeatedly for about `duration` of wall-clock time and print transactions/sec,
+// bytes/sec and allocations per transaction under `name`.
+BenchResult RunBench(std::string_view name, const BenchTransaction& txn,
+                     std::chrono::milliseconds duration = std::chrono::milliseconds(500));
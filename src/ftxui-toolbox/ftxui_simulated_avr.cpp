@@ -5,14 +5,23 @@
 #include <simavr/avr_twi.h>
 #include <simavr/avr_uart.h>
 #include <simavr/sim_avr.h>
-#include <simavr/sim_elf.h>
-#include <simavr/sim_gdb.h>
 #include <simavr/sim_irq.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
-#include <cstring>
+#include <cstdlib>
 #include <ftxui/component/task.hpp>
-#include <simavr-toolbox/sim_base.hpp>
+#include <simavr-toolbox/sim_firmware.hpp>
+#include <thread>
+
+// The governor looks at the clock once per simulated millisecond, sleeps at most kMaxSleep at a
+// time so queued tasks keep running, and gives up on catching up once it is kMaxLag behind.
+static constexpr uint32_t kPaceChecksPerSecond = 1000;
+static constexpr auto kMinSleep = std::chrono::milliseconds(1);
+static constexpr auto kMaxSleep = std::chrono::milliseconds(10);
+static constexpr auto kMaxLag = std::chrono::milliseconds(100);
+static constexpr auto kSpeedRatioWindow = std::chrono::milliseconds(250);
 
 FtxUiSimulatedAvr::FtxUiSimulatedAvr(std::string_view filename, bool gdb, TaskReceiver& receiver)
     : S_{receiver->MakeSender()} {
@@ -48,46 +57,157 @@ FtxUiSimulatedAvr::FtxUiSimulatedAvr(std::string_view filename, bool gdb, TaskRe
 }
 
 avr_t* FtxUiSimulatedAvr::LoadFirmware(std::string_view filename, bool gdb) {
-  avr_t* avr = nullptr;
-
-  elf_firmware_t f;
-  memset(&f, 0, sizeof(f));
-
-  elf_read_firmware(filename.data(), &f);
-
-  sim_debug_log("f=%d mmcu=%s\n", (int)f.frequency, f.mmcu);
-
-  avr = avr_make_mcu_by_name(f.mmcu);
-
+  avr_t* avr = LoadAvrFirmware(filename, gdb);
   if (!avr) {
-    sim_debug_log("AVR '%s' not known\n", f.mmcu);
     std::abort();
   }
-
-  avr_init(avr);
-
-  avr_load_firmware(avr, &f);
-
-  if (gdb) {
-    avr->gdb_port = 1234;
-    avr->state = cpu_Stopped;
-    avr_gdb_init(avr);
-  }
-
   return avr;
 }
 
+static bool IsRunning(int state) {
+  return (state != cpu_Done) && (state != cpu_Crashed);
+}
+
 void FtxUiSimulatedAvr::BlockingLoop(std::atomic_bool& keepGoing,
                                      ftxui::Receiver<ftxui::Closure>& receiver) {
   auto state = Avr_->state;
-  while ((state != cpu_Done) && (state != cpu_Crashed) && keepGoing) {
+  auto last_poll = std::chrono::steady_clock::now();
+  RebasePacing();
+  while (IsRunning(state) && keepGoing) {
     ftxui::Closure t;
     while (receiver->ReceiveNonBlocking(&t)) {
       t();
     }
     BeforeAvrCycleSideEffect();
-    state = avr_run(Avr_);
+
+    if (Loop_.Quantum == 0) {
+      state = avr_run(Avr_);
+      if (Avr_->cycle >= NextPaceCycle_) {
+        Pace();
+      }
+      continue;
+    }
+
+    state = RunQuantum();
+
+    // Measured before pacing: time spent sleeping is not simulation holding up the tasks, and
+    // counting it would shrink the quantum whenever the governor sleeps.
+    auto now = std::chrono::steady_clock::now();
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_poll);
+
+    StatQuanta_.fetch_add(1, std::memory_order_relaxed);
+    StatTaskLatencyNs_.store(latency.count(), std::memory_order_relaxed);
+    if (latency.count() > StatMaxTaskLatencyNs_.load(std::memory_order_relaxed)) {
+      StatMaxTaskLatencyNs_.store(latency.count(), std::memory_order_relaxed);
+    }
+    if (Loop_.Adaptive) {
+      AdaptQuantum(latency);
+    }
+
+    if (Avr_->cycle >= NextPaceCycle_) {
+      Pace();
+      now = std::chrono::steady_clock::now();
+    }
+    last_poll = now;
+  }
+}
+
+int FtxUiSimulatedAvr::RunQuantum() {
+  int state = Avr_->state;
+  if (Loop_.QuantumUnit == LoopConfig::Unit::Cycles) {
+    avr_cycle_count_t end = Avr_->cycle + Quantum_;
+    if (SpeedMode_ != SpeedMode::Unthrottled) {
+      // Don't let a long quantum run past the next pacing check.
+      end = std::min(end, std::max(NextPaceCycle_, Avr_->cycle + 1));
+    }
+    do {
+      state = avr_run(Avr_);
+    } while (IsRunning(state) && Avr_->cycle < end);
+  } else {
+    for (uint64_t i = 0; i < Quantum_ && IsRunning(state); ++i) {
+      state = avr_run(Avr_);
+    }
   }
+  return state;
+}
+
+void FtxUiSimulatedAvr::AdaptQuantum(std::chrono::nanoseconds latency) {
+  // Halve quickly when over target, grow slowly when well under it.
+  if (latency > Loop_.TargetLatency) {
+    Quantum_ /= 2;
+  } else if (latency < Loop_.TargetLatency / 2) {
+    Quantum_ += Quantum_ / 4 + 1;
+  }
+  Quantum_ = std::clamp(Quantum_, Loop_.MinQuantum, Loop_.MaxQuantum);
+  StatQuantum_.store(Quantum_, std::memory_order_relaxed);
+}
+
+void FtxUiSimulatedAvr::SetLoopConfig(const LoopConfig& config) {
+  Loop_ = config;
+  Quantum_ = config.Quantum;
+  StatQuantum_.store(Quantum_, std::memory_order_relaxed);
+  StatMaxTaskLatencyNs_.store(0, std::memory_order_relaxed);
+}
+
+void FtxUiSimulatedAvr::SetSpeed(SpeedMode mode, double multiple) {
+  SpeedMode_ = mode;
+  SpeedMultiple_ = (mode == SpeedMode::Multiple && multiple > 0) ? multiple : 1.0;
+  RebasePacing();
+}
+
+double FtxUiSimulatedAvr::GetSpeedRatio() const {
+  return StatSpeedRatio_.load(std::memory_order_relaxed);
+}
+
+void FtxUiSimulatedAvr::RebasePacing() {
+  PaceStart_ = RatioStart_ = std::chrono::steady_clock::now();
+  PaceStartCycle_ = RatioStartCycle_ = NextPaceCycle_ = Avr_->cycle;
+}
+
+void FtxUiSimulatedAvr::Pace() {
+  using namespace std::chrono;
+
+  const uint32_t frequency = Avr_->frequency;
+  const avr_cycle_count_t cycle = Avr_->cycle;
+  if (frequency == 0) {
+    return;
+  }
+  NextPaceCycle_ = cycle + std::max<avr_cycle_count_t>(frequency / kPaceChecksPerSecond, 1);
+
+  const auto now = steady_clock::now();
+  if (now - RatioStart_ >= kSpeedRatioWindow) {
+    const double simulated = double(cycle - RatioStartCycle_) / frequency;
+    StatSpeedRatio_.store(simulated / duration<double>(now - RatioStart_).count(),
+                          std::memory_order_relaxed);
+    RatioStart_ = now;
+    RatioStartCycle_ = cycle;
+  }
+
+  if (SpeedMode_ == SpeedMode::Unthrottled) {
+    return;
+  }
+
+  const auto target =
+      PaceStart_ + duration_cast<steady_clock::duration>(duration<double>(
+                       double(cycle - PaceStartCycle_) / frequency / SpeedMultiple_));
+  if (now - target > kMaxLag) {
+    // The host can't keep up, or the simulation was stopped in a debugger. Start again from here
+    // rather than running flat out to make up the difference.
+    PaceStart_ = now;
+    PaceStartCycle_ = cycle;
+  } else if (target - now >= kMinSleep) {
+    std::this_thread::sleep_until(std::min<steady_clock::time_point>(target, now + kMaxSleep));
+  }
+}
+
+FtxUiSimulatedAvr::LoopStats FtxUiSimulatedAvr::GetLoopStats() const {
+  return {
+      .Quantum = StatQuantum_.load(std::memory_order_relaxed),
+      .Quanta = StatQuanta_.load(std::memory_order_relaxed),
+      .TaskLatency = std::chrono::nanoseconds(StatTaskLatencyNs_.load(std::memory_order_relaxed)),
+      .MaxTaskLatency =
+          std::chrono::nanoseconds(StatMaxTaskLatencyNs_.load(std::memory_order_relaxed)),
+  };
 }
 
 void FtxUiSimulatedAvr::BeforeAvrCycleSideEffect() {
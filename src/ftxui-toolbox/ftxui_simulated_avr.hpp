@@ -2,6 +2,8 @@
 
 #include <simavr/sim_avr.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <ftxui/component/receiver.hpp>
 #include <ftxui/component/task.hpp>
@@ -11,12 +13,50 @@ using TaskReceiver = ftxui::Receiver<ftxui::Closure>;
 
 class FtxUiSimulatedAvr {
  public:
+  // How much BlockingLoop() runs between checks of the UI task queue.
+  struct LoopConfig {
+    enum class Unit { Cycles, Instructions };
+
+    // Cycles or instructions per quantum. 0 checks the queue before every instruction.
+    uint64_t Quantum{0};
+    Unit QuantumUnit{Unit::Cycles};
+    // Grow or shrink the quantum to keep the time between task queue checks near TargetLatency.
+    bool Adaptive{false};
+    std::chrono::microseconds TargetLatency{1000};
+    uint64_t MinQuantum{64};
+    uint64_t MaxQuantum{1 << 22};
+  };
+
+  // Safe to read from any thread.
+  struct LoopStats {
+    uint64_t Quantum{0};
+    uint64_t Quanta{0};
+    // Wall time between the last two task queue checks, not counting pacing sleeps, and the
+    // longest seen.
+    std::chrono::nanoseconds TaskLatency{0};
+    std::chrono::nanoseconds MaxTaskLatency{0};
+  };
+
+  enum class SpeedMode { Unthrottled, RealTime, Multiple };
+
   FtxUiSimulatedAvr(std::string_view filename, bool gdb, TaskReceiver& receiver);
   void BlockingLoop(std::atomic_bool&, TaskReceiver& receiver);
   static avr_t* LoadFirmware(std::string_view filename, bool gdb);
 
+  // Call before BlockingLoop(), or from a posted task.
+  void SetLoopConfig(const LoopConfig& config);
+  LoopStats GetLoopStats() const;
+
+  // Pace simulated time against the wall clock: at real time, at `multiple` times real time, or as
+  // fast as the host allows. Call before BlockingLoop(), or from a posted task.
+  void SetSpeed(SpeedMode mode, double multiple = 1.0);
+  // Simulated seconds per wall-clock second over the last measurement window. Safe to read from
+  // any thread.
+  double GetSpeedRatio() const;
+
  protected:
   virtual void OnUartByteReceived(int uartNumber, uint8_t byte);
+  // Called before every instruction, or once per quantum when LoopConfig::Quantum is set.
   virtual void BeforeAvrCycleSideEffect();
 
   void Post(ftxui::Closure&& f);
@@ -24,4 +64,26 @@ class FtxUiSimulatedAvr {
   TaskSender S_;
   avr_irq_t* GetPinIrq(char pin, uint8_t index);
   avr_t* Avr_{nullptr};
+
+ private:
+  int RunQuantum();
+  void AdaptQuantum(std::chrono::nanoseconds latency);
+  void Pace();
+  void RebasePacing();
+
+  LoopConfig Loop_;
+  uint64_t Quantum_{0};
+  std::atomic<uint64_t> StatQuantum_{0};
+  std::atomic<uint64_t> StatQuanta_{0};
+  std::atomic<int64_t> StatTaskLatencyNs_{0};
+  std::atomic<int64_t> StatMaxTaskLatencyNs_{0};
+
+  SpeedMode SpeedMode_{SpeedMode::Unthrottled};
+  double SpeedMultiple_{1.0};
+  avr_cycle_count_t NextPaceCycle_{0};
+  std::chrono::steady_clock::time_point PaceStart_;
+  avr_cycle_count_t PaceStartCycle_{0};
+  std::chrono::steady_clock::time_point RatioStart_;
+  avr_cycle_count_t RatioStartCycle_{0};
+  std::atomic<double> StatSpeedRatio_{0.0};
 };
@@ -3,7 +3,6 @@
 #include <array>
 #include <cstdint>
 #include <cstdlib>
-#include <deque>
 #include <format>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/component_base.hpp>
@@ -28,11 +27,12 @@ class I2CListenerRendererBase : public ftxui::ComponentBase {
   I2CListenerRendererBase(avr_t* avr) : i2c_listener_(avr) {
     // Create a simple scroller with all I2C messages
     Add(ftxui::Renderer([&] { return RenderI2CListener(); }));
-    i2c_listener_.OnMessage([this](const auto& m) { OnI2cMessage(m); });
   }
 
  private:
   ftxui::Element RenderI2CListener() {
+    Update(i2c_listener_.GetMessagesSnapshot().Read());
+
     // If no messages yet, show a placeholder
     if (ReceivedMessages_.empty()) {
       return ftxui::vbox({ftxui::text("I2C Listener") | ftxui::bold, ftxui::separator(),
@@ -63,14 +63,28 @@ class I2CListenerRendererBase : public ftxui::ComponentBase {
  private:
   typedef std::pair<SimI2CListener::Message, uint32_t> MessageWithCount;
 
-  void OnI2cMessage(const SimI2CListener::Message& m) {
-    if (!ReceivedMessages_.empty() && ReceivedMessages_.front().first == m) {
-      ReceivedMessages_.front().second += 1;
-    } else {
-      ReceivedMessages_.emplace_front(m, 0);
+  // Collapse runs of identical messages in a newly published snapshot, newest first.
+  void Update(const SimSnapshot<SimI2CListener::FinishedMessages>::Version& snapshot) {
+    if (snapshot.Generation == Generation_) {
+      return;
+    }
+    Generation_ = snapshot.Generation;
+    ReceivedMessages_.clear();
+    for (const auto& m : snapshot.Value) {
+      if (!ReceivedMessages_.empty() && SameContent(ReceivedMessages_.back().first, m)) {
+        ReceivedMessages_.back().second += 1;
+      } else {
+        ReceivedMessages_.emplace_back(m, 1);
+      }
     }
   }
 
+  // Equal but for when they happened.
+  static bool SameContent(const SimI2CListener::Message& a, const SimI2CListener::Message& b) {
+    return a.Address == b.Address && a.Type == b.Type && a.RepeatedStart == b.RepeatedStart &&
+           a.WriteBuffer == b.WriteBuffer && a.ReadBuffer == b.ReadBuffer;
+  }
+
   static std::string RenderMessage(const SimI2CListener::Message& message, uint32_t count) {
     auto x = std::format("R/W: {} RS: {}",
                          message.Type.has_value()
@@ -102,7 +116,8 @@ class I2CListenerRendererBase : public ftxui::ComponentBase {
   }
 
   SimI2CListener i2c_listener_;
-  std::deque<MessageWithCount> ReceivedMessages_;
+  uint64_t Generation_{0};
+  std::vector<MessageWithCount> ReceivedMessages_;
   std::unordered_map<uint8_t /* Address  */, ftxui::Color> AddressColorMap_;
 };
 
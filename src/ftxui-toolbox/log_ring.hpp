@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bounded ring of log lines written by one producer (the simulation thread) and read by the UI.
+// Lines live in preallocated slots, so Insert() is wait-free and never allocates; lines longer
+// than kLineBytes are truncated. Readers never block the producer: each slot carries a sequence
+// number, and a reader that finds a slot rewritten under it stops at the lines it has already
+// copied, which are exactly the newest lines still held.
+class LogRing {
+ public:
+  static constexpr size_t kCapacity = 256;
+  static constexpr size_t kLineBytes = 192;
+
+  void Insert(std::string_view s) {
+    const uint64_t n = Head_.load(std::memory_order_relaxed);
+    Slot& slot = Slots_[n % kCapacity];
+
+    // An odd sequence marks the slot as being written.
+    slot.Sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t length = std::min(s.size(), kLineBytes);
+    slot.Length.store(length, std::memory_order_relaxed);
+    for (size_t i = 0; i * sizeof(uint64_t) < length; ++i) {
+      uint64_t word = 0;
+      std::memcpy(&word, s.data() + i * sizeof(uint64_t),
+                  std::min(sizeof(uint64_t), length - i * sizeof(uint64_t)));
+      slot.Text[i].store(word, std::memory_order_relaxed);
+    }
+
+    slot.Sequence.store(2 * n + 2, std::memory_order_release);
+    Head_.store(n + 1, std::memory_order_release);
+  }
+
+  // Copy of the lines currently held, newest first.
+  std::vector<std::string> Snapshot() const {
+    std::vector<std::string> lines;
+    const uint64_t head = Head_.load(std::memory_order_acquire);
+    lines.reserve(std::min<uint64_t>(head, kCapacity));
+
+    char text[kLineBytes];
+    for (uint64_t n = head; n > 0 && head - n < kCapacity; --n) {
+      const Slot& slot = Slots_[(n - 1) % kCapacity];
+      const uint64_t sequence = slot.Sequence.load(std::memory_order_acquire);
+      if (sequence != 2 * (n - 1) + 2) {
+        break;
+      }
+
+      const size_t length = std::min<size_t>(slot.Length.load(std::memory_order_relaxed),
+                                             kLineBytes);
+      for (size_t i = 0; i * sizeof(uint64_t) < length; ++i) {
+        uint64_t word = slot.Text[i].load(std::memory_order_relaxed);
+        std::memcpy(text + i * sizeof(uint64_t), &word,
+                    std::min(sizeof(uint64_t), length - i * sizeof(uint64_t)));
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.Sequence.load(std::memory_order_relaxed) != sequence) {
+        // The producer lapped us; everything older is gone too.
+        break;
+      }
+      lines.emplace_back(text, length);
+    }
+    return lines;
+  }
+
+  // Visit a snapshot of the held lines, newest first.
+  void ForEach(std::function<void(const std::string&)> f) const {
+    for (const auto& line : Snapshot()) {
+      f(line);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> Sequence{0};
+    std::atomic<uint32_t> Length{0};
+    std::array<std::atomic<uint64_t>, kLineBytes / sizeof(uint64_t)> Text{};
+  };
+
+  alignas(64) std::atomic<uint64_t> Head_{0};
+  alignas(64) std::array<Slot, kCapacity> Slots_{};
+};
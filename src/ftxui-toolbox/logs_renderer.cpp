@@ -1,11 +1,11 @@
 #include "logs_renderer.hpp"
 
-#include "locked_dequeue.hpp"
+#include "log_ring.hpp"
 #include "scroller.hpp"
 
 class LogsRendererBase : public ftxui::ComponentBase {
  public:
-  LogsRendererBase(const LockedDequeue& logs) : Logs_(logs) {
+  LogsRendererBase(const LogRing& logs) : Logs_(logs) {
     auto log_renderer = ftxui::Renderer([&] {
       ftxui::Elements elements;
       Logs_.ForEach([&](const std::string& s) { elements.push_back(ftxui::text(s)); });
@@ -22,9 +22,9 @@ class LogsRendererBase : public ftxui::ComponentBase {
   }
 
  private:
-  const LockedDequeue& Logs_;
+  const LogRing& Logs_;
 };
 
-ftxui::Component LogsRenderer(const LockedDequeue& logs) {
+ftxui::Component LogsRenderer(const LogRing& logs) {
   return ftxui::Make<LogsRendererBase>(logs);
 }
@@ -2,6 +2,6 @@
 
 #include <ftxui/component/component.hpp>
 
-#include "locked_dequeue.hpp"
+#include "log_ring.hpp"
 
-ftxui::Component LogsRenderer(const LockedDequeue& logs);
+ftxui::Component LogsRenderer(const LogRing& logs);
@@ -0,0 +1,167 @@
+#include "fleet_runner.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// A job queue owned by one worker. Jobs are whole board runs, so a mutex per queue costs nothing
+// measurable next to the work it hands out.
+class WorkQueue {
+ public:
+  void Push(size_t job) {
+    std::lock_guard lock(Mutex_);
+    Jobs_.push_back(job);
+  }
+
+  std::optional<size_t> PopNewest() {
+    std::lock_guard lock(Mutex_);
+    if (Jobs_.empty()) {
+      return std::nullopt;
+    }
+    size_t job = Jobs_.back();
+    Jobs_.pop_back();
+    return job;
+  }
+
+  std::optional<size_t> StealOldest() {
+    std::lock_guard lock(Mutex_);
+    if (Jobs_.empty()) {
+      return std::nullopt;
+    }
+    size_t job = Jobs_.front();
+    Jobs_.pop_front();
+    return job;
+  }
+
+ private:
+  std::mutex Mutex_;
+  std::deque<size_t> Jobs_;
+};
+
+}  // namespace
+
+avr_cycle_count_t FleetRunner::Summary::TotalCycles() const {
+  avr_cycle_count_t total = 0;
+  for (const auto& result : Results) {
+    total += result.Report.Cycles;
+  }
+  return total;
+}
+
+double FleetRunner::Summary::AggregateMhz() const {
+  if (WallTime.count() == 0) {
+    return 0;
+  }
+  return static_cast<double>(TotalCycles()) * 1000.0 / static_cast<double>(WallTime.count());
+}
+
+size_t FleetRunner::Summary::CrashedCount() const {
+  return std::count_if(Results.begin(), Results.end(),
+                       [](const auto& result) { return result.Report.FinalState == cpu_Crashed; });
+}
+
+size_t FleetRunner::Summary::FailedCount() const {
+  return std::count_if(Results.begin(), Results.end(),
+                       [](const auto& result) { return !result.Error.empty(); });
+}
+
+FleetRunner::FleetRunner(unsigned threads)
+    : Threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+void FleetRunner::Add(Job job) {
+  Jobs_.push_back(std::move(job));
+}
+
+FleetRunner::Summary FleetRunner::Run() {
+  using Clock = std::chrono::steady_clock;
+
+  const unsigned threads = std::max(1u, std::min<unsigned>(Threads_, Jobs_.size()));
+  std::vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < Jobs_.size(); ++i) {
+    queues[i % threads].Push(i);
+  }
+
+  Summary summary;
+  summary.Results.resize(Jobs_.size());
+  summary.Workers.resize(threads);
+
+  // Each worker writes only its own WorkerReport and the Results of the jobs it ran.
+  auto work = [&](unsigned self) {
+    WorkerReport& report = summary.Workers[self];
+    for (;;) {
+      bool stolen = false;
+      std::optional<size_t> job = queues[self].PopNewest();
+      for (unsigned i = 1; !job && i < threads; ++i) {
+        job = queues[(self + i) % threads].StealOldest();
+        stolen = job.has_value();
+      }
+      if (!job) {
+        // Nothing is ever queued after the start, so empty queues everywhere means done.
+        return;
+      }
+
+      const Job& spec = Jobs_[*job];
+      const auto start = Clock::now();
+      // A bad firmware image fails its own job, not the whole fleet.
+      if (auto runner = HeadlessRunner::Load(spec.Firmware)) {
+        if (spec.Setup) {
+          spec.Setup(*runner);
+        }
+        summary.Results[*job] = {spec.Name, runner->Run(spec.Budget), self, stolen};
+      } else {
+        summary.Results[*job] = {.Name = spec.Name,
+                                 .Worker = self,
+                                 .Stolen = stolen,
+                                 .Error = std::format("cannot load {}", spec.Firmware)};
+      }
+      report.BusyTime += Clock::now() - start;
+      report.Jobs += 1;
+      report.Steals += stolen;
+    }
+  };
+
+  const auto start = Clock::now();
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.emplace_back(work, i);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  summary.WallTime = Clock::now() - start;
+  return summary;
+}
+
+std::string FormatSummary(const FleetRunner::Summary& summary) {
+  std::string s;
+  for (const auto& result : summary.Results) {
+    if (!result.Error.empty()) {
+      s += std::format("{:<24} failed: {}  worker {}{}\n", result.Name, result.Error,
+                       result.Worker, result.Stolen ? " (stolen)" : "");
+      continue;
+    }
+    s += std::format("{:<24} {:>14} cycles {:>10.3f} MHz  state {}  worker {}{}\n", result.Name,
+                     result.Report.Cycles, result.Report.SimulatedMhz(), result.Report.FinalState,
+                     result.Worker, result.Stolen ? " (stolen)" : "");
+  }
+  for (size_t i = 0; i < summary.Workers.size(); ++i) {
+    const auto& worker = summary.Workers[i];
+    s += std::format("worker {:<3} {} jobs, {} stolen, busy {:.3f} ms\n", i, worker.Jobs,
+                     worker.Steals,
+                     std::chrono::duration<double, std::milli>(worker.BusyTime).count());
+  }
+  s += std::format("boards:          {} ({} crashed, {} failed)\n", summary.Results.size(),
+                   summary.CrashedCount(), summary.FailedCount());
+  s += std::format("wall time:       {:.3f} ms\n",
+                   std::chrono::duration<double, std::milli>(summary.WallTime).count());
+  s += std::format("total cycles:    {}\n", summary.TotalCycles());
+  s += std::format("aggregate MHz:   {:.3f}\n", summary.AggregateMhz());
+  return s;
+}
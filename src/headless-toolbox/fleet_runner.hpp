@@ -0,0 +1,72 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "headless_runner.hpp"
+
+// Runs many independent boards on a pool of worker threads and collects a report for each. Every
+// board is built, run and torn down on the one worker that picked it up. Give each board a log sink
+// through HeadlessRunner::Log() in Setup; boards without one share the process-wide log function,
+// which must then be thread-safe.
+//
+// Jobs are dealt round-robin to per-worker queues. A worker takes its own jobs newest first and,
+// once its queue is empty, steals the oldest job from another worker, so long-running boards don't
+// leave the other threads idle.
+class FleetRunner {
+ public:
+  // Attaches peripherals to a freshly loaded board, on the worker thread that will run it.
+  using SetupFn = std::function<void(HeadlessRunner&)>;
+
+  struct Job {
+    std::string Name;
+    std::string Firmware;
+    HeadlessRunner::Budget Budget;
+    SetupFn Setup;
+  };
+
+  struct Result {
+    std::string Name;
+    HeadlessRunner::Report Report;
+    unsigned Worker{0};
+    bool Stolen{false};
+    // Set when the board could not be built; Report is then empty.
+    std::string Error;
+  };
+
+  struct WorkerReport {
+    unsigned Jobs{0};
+    unsigned Steals{0};
+    std::chrono::nanoseconds BusyTime{0};
+  };
+
+  struct Summary {
+    // In the order the jobs were added.
+    std::vector<Result> Results;
+    std::vector<WorkerReport> Workers;
+    std::chrono::nanoseconds WallTime{0};
+
+    avr_cycle_count_t TotalCycles() const;
+    // Simulated cycles per wall-clock microsecond, summed over all boards.
+    double AggregateMhz() const;
+    size_t CrashedCount() const;
+    size_t FailedCount() const;
+  };
+
+  // 0 uses one thread per hardware thread.
+  explicit FleetRunner(unsigned threads = 0);
+
+  void Add(Job job);
+  Summary Run();
+
+ private:
+  unsigned Threads_{1};
+  std::vector<Job> Jobs_;
+};
+
+std::string FormatSummary(const FleetRunner::Summary& summary);
@@ -0,0 +1,144 @@
+#include "headless_runner.hpp"
+
+#include <simavr/avr_twi.h>
+
+#include <cstdlib>
+#include <format>
+#include <simavr-toolbox/ds3231_virt.h>
+#include <simavr-toolbox/sim_firmware.hpp>
+
+// Reading the wall clock costs about as much as a few instructions, so only look at it every so
+// many avr_run() calls.
+static constexpr unsigned kWallClockCheckInterval = 4096;
+
+double HeadlessRunner::Report::SimulatedMhz() const {
+  if (WallTime.count() == 0) {
+    return 0;
+  }
+  // cycles per ns * 1000 == cycles per us == MHz
+  return static_cast<double>(Cycles) * 1000.0 / static_cast<double>(WallTime.count());
+}
+
+double HeadlessRunner::Report::HostNsPerCycle() const {
+  if (Cycles == 0) {
+    return 0;
+  }
+  return static_cast<double>(WallTime.count()) / static_cast<double>(Cycles);
+}
+
+static avr_t* LoadOrAbort(std::string_view filename, bool gdb) {
+  avr_t* avr = LoadAvrFirmware(filename, gdb);
+  if (!avr) {
+    std::abort();
+  }
+  return avr;
+}
+
+HeadlessRunner::HeadlessRunner(std::string_view filename, bool gdb)
+    : HeadlessRunner(LoadOrAbort(filename, gdb)) {}
+
+HeadlessRunner::HeadlessRunner(avr_t* avr)
+    : Avr_(avr),
+      Log_(SimLogContext::Get(Avr_)),
+      State_(std::make_unique<SimBoardState>(Avr_)) {}
+
+std::unique_ptr<HeadlessRunner> HeadlessRunner::Load(std::string_view filename, bool gdb) {
+  avr_t* avr = LoadAvrFirmware(filename, gdb);
+  if (!avr) {
+    return nullptr;
+  }
+  return std::unique_ptr<HeadlessRunner>(new HeadlessRunner(avr));
+}
+
+HeadlessRunner::~HeadlessRunner() {
+  Checkpoints_.reset();
+  State_.reset();
+  Counters_.clear();
+  Owned_.clear();
+  Log_.reset();
+  avr_terminate(Avr_);
+  std::free(Avr_);
+}
+
+avr_t* HeadlessRunner::Avr() const {
+  return Avr_;
+}
+
+SimLogContext& HeadlessRunner::Log() {
+  return *Log_;
+}
+
+void HeadlessRunner::AddPeripheral(std::string name, CallbackCounter counter) {
+  Counters_.emplace_back(std::move(name), std::move(counter));
+}
+
+void HeadlessRunner::AttachDs3231(bool lazy) {
+  auto rtc = std::make_shared<ds3231_virt_t>();
+  ds3231_virt_init(Avr_, rtc.get());
+  ds3231_virt_attach_twi(rtc.get(), AVR_IOCTL_TWI_GETIRQ(0));
+  ds3231_virt_set_lazy(rtc.get(), lazy);
+  Owned_.push_back(rtc);
+  State_->Add(rtc.get());
+  AddPeripheral("ds3231", [rtc] { return rtc->callback_count; });
+}
+
+void HeadlessRunner::EnableCheckpoints(const SimCheckpointRing::Config& config) {
+  Checkpoints_ = std::make_unique<SimCheckpointRing>(*State_, config);
+}
+
+HeadlessRunner::Report HeadlessRunner::Run(const Budget& budget) {
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<uint64_t> startCounts;
+  startCounts.reserve(Counters_.size());
+  for (const auto& [_, counter] : Counters_) {
+    startCounts.push_back(counter());
+  }
+
+  const avr_cycle_count_t startCycle = Avr_->cycle;
+  const auto start = Clock::now();
+  const auto deadline = start + budget.MaxWallTime;
+
+  int state = Avr_->state;
+  unsigned untilClockCheck = kWallClockCheckInterval;
+  while ((state != cpu_Done) && (state != cpu_Crashed)) {
+    state = avr_run(Avr_);
+
+    if (Checkpoints_) {
+      Checkpoints_->Poll();
+    }
+
+    if (budget.MaxCycles && (Avr_->cycle - startCycle) >= budget.MaxCycles) {
+      break;
+    }
+
+    if (budget.MaxWallTime.count() && --untilClockCheck == 0) {
+      untilClockCheck = kWallClockCheckInterval;
+      if (Clock::now() >= deadline) {
+        break;
+      }
+    }
+  }
+
+  Report report;
+  report.WallTime = Clock::now() - start;
+  report.Cycles = Avr_->cycle - startCycle;
+  report.FinalState = state;
+  for (size_t i = 0; i < Counters_.size(); ++i) {
+    report.Peripherals.push_back({Counters_[i].first, Counters_[i].second() - startCounts[i]});
+  }
+  return report;
+}
+
+std::string FormatReport(const HeadlessRunner::Report& report) {
+  auto s = std::format("cycles:          {}\n", report.Cycles);
+  s += std::format("wall time:       {:.3f} ms\n",
+                   std::chrono::duration<double, std::milli>(report.WallTime).count());
+  s += std::format("simulated MHz:   {:.3f}\n", report.SimulatedMhz());
+  s += std::format("host ns / cycle: {:.3f}\n", report.HostNsPerCycle());
+  s += std::format("final state:     {}\n", report.FinalState);
+  for (const auto& p : report.Peripherals) {
+    s += std::format("  {:<16} {} callbacks\n", p.Name, p.Callbacks);
+  }
+  return s;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <simavr-toolbox/sim_board_state.hpp>
+#include <simavr-toolbox/sim_checkpoint_ring.hpp>
+#include <simavr-toolbox/sim_log_context.hpp>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Runs a firmware image with a set of toolbox peripherals attached and no UI, and measures how fast
+// the simulation went.
+class HeadlessRunner {
+ public:
+  // Stop conditions for Run(). A zero value means "no limit"; when both are zero the firmware runs
+  // until it finishes or crashes.
+  struct Budget {
+    avr_cycle_count_t MaxCycles{0};
+    std::chrono::milliseconds MaxWallTime{0};
+  };
+
+  struct PeripheralReport {
+    std::string Name;
+    uint64_t Callbacks;
+  };
+
+  struct Report {
+    avr_cycle_count_t Cycles{0};
+    std::chrono::nanoseconds WallTime{0};
+    int FinalState{cpu_Limbo};
+    std::vector<PeripheralReport> Peripherals;
+
+    double SimulatedMhz() const;
+    double HostNsPerCycle() const;
+  };
+
+  using CallbackCounter = std::function<uint64_t()>;
+
+  // Aborts if the firmware cannot be loaded.
+  HeadlessRunner(std::string_view filename, bool gdb = false);
+  // Returns null if the firmware cannot be loaded; LoadAvrFirmware() logs why.
+  static std::unique_ptr<HeadlessRunner> Load(std::string_view filename, bool gdb = false);
+  // Releases the peripherals the runner owns, then the AVR itself. Peripherals added with
+  // AddPeripheral() must already be gone.
+  ~HeadlessRunner();
+  HeadlessRunner(const HeadlessRunner&) = delete;
+  HeadlessRunner& operator=(const HeadlessRunner&) = delete;
+
+  avr_t* Avr() const;
+  // The board's log context, kept for as long as the runner. Set a sink here to give the board its
+  // own log.
+  SimLogContext& Log();
+
+  // Track a peripheral the caller owns. `counter` returns its cumulative callback count.
+  void AddPeripheral(std::string name, CallbackCounter counter);
+
+  // Construct a SimAvrI2CComponent-like peripheral bound to this AVR, owned by the runner.
+  // Peripherals that can save their state are added to State().
+  template <class T, class... Args>
+  T& Attach(std::string name, Args&&... args) {
+    auto p = std::make_shared<T>(Avr_, std::forward<Args>(args)...);
+    Owned_.push_back(p);
+    AddPeripheral(std::move(name), [p] { return p->GetCallbackCount(); });
+    if constexpr (std::is_base_of_v<SimStateful, T>) {
+      State_->Add(*p);
+    }
+    return *p;
+  }
+
+  // Attach a DS3231 RTC to TWI 0, optionally in lazy timekeeping mode.
+  void AttachDs3231(bool lazy = false);
+
+  Report Run(const Budget& budget);
+
+  // Snapshot, restore and fork the board. Two runners built from the same firmware with the same
+  // peripherals attached in the same order can fork into each other.
+  SimBoardState& State() { return *State_; }
+
+  // Keep a checkpoint ring while Run() runs, so the board can be wound back with
+  // Checkpoints()->RewindTo(). Attach peripherals first. Checkpoints() is null until enabled.
+  void EnableCheckpoints(const SimCheckpointRing::Config& config);
+  SimCheckpointRing* Checkpoints() { return Checkpoints_.get(); }
+
+ private:
+  explicit HeadlessRunner(avr_t* avr);
+
+  avr_t* Avr_{nullptr};
+  std::shared_ptr<SimLogContext> Log_;
+  std::unique_ptr<SimBoardState> State_;
+  std::unique_ptr<SimCheckpointRing> Checkpoints_;
+  std::vector<std::shared_ptr<void>> Owned_;
+  std::vector<std::pair<std::string, CallbackCounter>> Counters_;
+};
+
+std::string FormatReport(const HeadlessRunner::Report& report);
@@ -0,0 +1,26 @@
+// Expands a trace file written by SimTraceLog::Dump() (e.g. simavr-runner --trace=FILE) into text,
+// one line per logged message, prefixed with the AVR cycle it was logged at.
+
+#include <cstdio>
+#include <simavr-toolbox/sim_trace_log.hpp>
+#include <string>
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s TRACE_FILE\n", argv[0]);
+    return 1;
+  }
+
+  bool ok = SimTraceLog::Decode(argv[1], [](avr_cycle_count_t cycle, const std::string& text) {
+    std::printf("%12llu  %s", static_cast<unsigned long long>(cycle), text.c_str());
+    if (text.empty() || text.back() != '\n') {
+      std::putchar('\n');
+    }
+  });
+
+  if (!ok) {
+    std::fprintf(stderr, "%s: not a complete trace file\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+// Runs a set of firmware images as independent boards across a pool of threads and prints a report
+// for each board plus the aggregate simulation speed.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fleet_runner.hpp"
+
+static void Usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s [options] FIRMWARE.elf...\n"
+               "  --jobs=N            worker threads (default: one per hardware thread)\n"
+               "  --cycles=N          stop each board after N simulated cycles\n"
+               "  --millis=N          stop each board after N ms of wall-clock time\n"
+               "  --repeat=N          run each firmware on N boards\n",
+               argv0);
+}
+
+static bool ConsumeOption(std::string_view arg, std::string_view name, std::string_view& value) {
+  if (!arg.starts_with(name) || arg.size() <= name.size() || arg[name.size()] != '=') {
+    return false;
+  }
+  value = arg.substr(name.size() + 1);
+  return true;
+}
+
+static unsigned long ParseNumber(std::string_view value) {
+  return std::strtoul(std::string(value).c_str(), nullptr, 0);
+}
+
+int main(int argc, char** argv) {
+  unsigned threads = 0;
+  unsigned long repeat = 1;
+  HeadlessRunner::Budget budget;
+  std::vector<std::string> firmware;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    std::string_view value;
+
+    if (ConsumeOption(arg, "--jobs", value)) {
+      threads = ParseNumber(value);
+    } else if (ConsumeOption(arg, "--cycles", value)) {
+      budget.MaxCycles = ParseNumber(value);
+    } else if (ConsumeOption(arg, "--millis", value)) {
+      budget.MaxWallTime = std::chrono::milliseconds(ParseNumber(value));
+    } else if (ConsumeOption(arg, "--repeat", value)) {
+      repeat = ParseNumber(value);
+    } else if (arg.starts_with("--")) {
+      Usage(argv[0]);
+      return 1;
+    } else {
+      firmware.emplace_back(arg);
+    }
+  }
+
+  if (firmware.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  FleetRunner fleet(threads);
+  for (const auto& file : firmware) {
+    for (unsigned long n = 0; n < repeat; ++n) {
+      fleet.Add({std::format("{}#{}", file, n), file, budget, nullptr});
+    }
+  }
+
+  auto summary = fleet.Run();
+  std::fputs(FormatSummary(summary).c_str(), stdout);
+  return (summary.CrashedCount() || summary.FailedCount()) ? 2 : 0;
+}
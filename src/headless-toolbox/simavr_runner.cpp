@@ -0,0 +1,128 @@
+// Headless firmware runner: loads an ELF, attaches the requested toolbox peripherals, runs until a
+// cycle or wall-clock budget is spent and prints the achieved simulation speed.
+
+#include <simavr/avr_ioport.h>
+#include <simavr/sim_io.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <optional>
+#include <simavr-toolbox/sim_47l04.h>
+#include <simavr-toolbox/sim_gu7000_i2c.hpp>
+#include <simavr-toolbox/sim_tca8418.hpp>
+#include <simavr-toolbox/sim_tlc59116.hpp>
+#include <simavr-toolbox/sim_trace_log.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "headless_runner.hpp"
+
+static void Usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s FIRMWARE.elf [options]\n"
+               "  --cycles=N          stop after N simulated cycles\n"
+               "  --millis=N          stop after N ms of wall-clock time\n"
+               "  --ds3231[=lazy]     attach a DS3231 RTC, optionally with lazy timekeeping\n"
+               "  --gu7000[=ADDR]     attach a GU7000 VFD on I2C, at 0x50 by default\n"
+               "  --tca8418[=PN]      attach a TCA8418 keypad, INT wired to port P pin N\n"
+               "  --tlc59116=ADDR     attach a TLC59116 LED driver (repeatable)\n"
+               "  --47l04=A2A1        attach a 47L04 EEPROM, e.g. --47l04=01 (repeatable)\n"
+               "  --trace=FILE        record debug log messages and write them to FILE for\n"
+               "                      sim-trace-decode\n",
+               argv0);
+}
+
+static bool ConsumeOption(std::string_view arg, std::string_view name, std::string_view& value) {
+  if (!arg.starts_with(name)) {
+    return false;
+  }
+  arg.remove_prefix(name.size());
+  if (!arg.empty() && arg.front() != '=') {
+    return false;
+  }
+  value = arg.empty() ? arg : arg.substr(1);
+  return true;
+}
+
+static unsigned long ParseNumber(std::string_view value) {
+  return std::strtoul(std::string(value).c_str(), nullptr, 0);
+}
+
+// A device whose address another one already has is left off the bus; the board still runs.
+static void ReportIfNotAttached(const SimAvrI2CComponent& device, std::string_view name) {
+  if (!device.IsAttached()) {
+    std::fprintf(stderr, "%.*s: I2C address already in use, not attached\n",
+                 static_cast<int>(name.size()), name.data());
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  HeadlessRunner runner(argv[1]);
+  avr_t* avr = runner.Avr();
+  HeadlessRunner::Budget budget;
+  std::optional<SimTraceLog> trace;
+  std::string trace_file;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    std::string_view value;
+
+    if (ConsumeOption(arg, "--cycles", value)) {
+      budget.MaxCycles = ParseNumber(value);
+    } else if (ConsumeOption(arg, "--millis", value)) {
+      budget.MaxWallTime = std::chrono::milliseconds(ParseNumber(value));
+    } else if (ConsumeOption(arg, "--ds3231", value)) {
+      runner.AttachDs3231(value == "lazy");
+    } else if (ConsumeOption(arg, "--gu7000", value)) {
+      auto address = value.empty() ? SimGu7000I2C::kDefaultAddress
+                                   : static_cast<uint8_t>(ParseNumber(value));
+      auto name = std::format("gu7000@{:02x}", address);
+      ReportIfNotAttached(runner.Attach<SimGu7000I2C>(name, address), name);
+    } else if (ConsumeOption(arg, "--tca8418", value)) {
+      avr_irq_t* intIrq = nullptr;
+      if (value.size() == 2) {
+        intIrq = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(value[0]), value[1] - '0');
+      } else {
+        // Nobody is listening to the INT line; give it an unconnected IRQ to toggle.
+        intIrq = avr_alloc_irq(&avr->irq_pool, 0, 1, nullptr);
+      }
+      ReportIfNotAttached(runner.Attach<SimTca8418>("tca8418", intIrq), "tca8418");
+    } else if (ConsumeOption(arg, "--tlc59116", value) && !value.empty()) {
+      auto address = static_cast<uint8_t>(ParseNumber(value));
+      auto name = std::format("tlc59116@{:02x}", address);
+      ReportIfNotAttached(runner.Attach<SimTLC59116>(name, address), name);
+    } else if (ConsumeOption(arg, "--47l04", value) && value.size() == 2) {
+      auto name = std::format("47l04@{}", value);
+      ReportIfNotAttached(runner.Attach<Sim47LXX>(name, value[0] == '1', value[1] == '1'), name);
+    } else if (ConsumeOption(arg, "--trace", value) && !value.empty()) {
+      trace_file = value;
+      trace.emplace(avr);
+      trace->Install();
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  auto report = runner.Run(budget);
+  std::fputs(FormatReport(report).c_str(), stdout);
+
+  if (trace) {
+    trace->Uninstall();
+    if (!trace->Dump(trace_file.c_str())) {
+      std::fprintf(stderr, "could not write trace to %s\n", trace_file.c_str());
+      return 1;
+    }
+    std::printf("trace: %zu entries (%llu dropped) written to %s\n", trace->Size(),
+                static_cast<unsigned long long>(trace->Dropped()), trace_file.c_str());
+  }
+  return 0;
+}
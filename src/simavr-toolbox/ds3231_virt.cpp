@@ -73,10 +73,12 @@
 #define DS3231_CONTROL_EOSC 7
 
 #define DS3231_CLK_FREQ 32768
-#define DS3231_CLK_PERIOD_US (1000000 / DS3231_CLK_FREQ)
 
 // Generic unpack of 8bit BCD register. Don't use on seconds or hours.
 #define UNPACK_BCD(x) (((x) & 0x0F) + ((x) >> 4) * 10)
+#define PACK_BCD(x) ((((x) / 10) << 4) | ((x) % 10))
+
+#define DS3231_SECONDS_PER_DAY 86400
 
 enum {
   DS3231_TWI_IRQ_OUTPUT = 0,
@@ -112,6 +114,8 @@ static inline int ds3231_get_flag(uint8_t reg, uint8_t bit) {
   return (reg & (1 << bit)) != 0;
 }
 
+static void ds3231_virt_schedule_square_wave(ds3231_virt_t *p);
+
 /*
  * Increment the ds3231 register address.
  */
@@ -127,20 +131,23 @@ static void ds3231_virt_incr_addr(ds3231_virt_t *const p) {
 /*
  * Update the system behaviour after a control register is written to.
  */
-static void ds3231_virt_update(const ds3231_virt_t *const p) {
+static void ds3231_virt_update(ds3231_virt_t *const p) {
   // The address of the register which was just updated
   switch (p->reg_addr) {
     case DS3231_VIRT_SECONDS:
+      // Writing the seconds register resets the countdown chain
+      p->epoch_cycle = p->avr->cycle;
       if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_EOSC) == 0) {
-        sim_debug_log("DS3231 clock ticking\n");
+        sim_debug_log(p->avr, "DS3231 clock ticking\n");
       } else {
-        sim_debug_log("DS3231 clock stopped\n");
+        sim_debug_log(p->avr, "DS3231 clock stopped\n");
       }
       break;
     case DS3231_VIRT_CONTROL:
-      sim_debug_log("DS3231 control register updated\n");
+      sim_debug_log(p->avr, "DS3231 control register updated\n");
       // TODO: Check if changing the prescaler resets the clock counter
       // and if so do it here?
+      ds3231_virt_schedule_square_wave(p);
       break;
     default:
       // No control register updated
@@ -187,61 +194,14 @@ static uint8_t ds3231_virt_tick_bcd_reg(bcd_reg_t *bcd_reg) {
 }
 
 /*
- * Ticks the time registers. See table 3, p10 of the DS3231 datasheet.
+ * Ticks the date registers by one day. See table 3, p10 of the DS3231 datasheet.
  */
-static void ds3231_virt_tick_time(ds3231_virt_t *p) {
-  /*
-   * Seconds
-   */
-  bcd_reg_t reg = {
-      .reg = &p->nvram[DS3231_VIRT_SECONDS], .min_val = 0, .max_val = 59, .tens_mask = 0b01110000};
-  uint8_t cascade = ds3231_virt_tick_bcd_reg(&reg);
-  if (!cascade) return;
-
-  /*
-   * Minutes
-   */
-  reg.reg = &p->nvram[DS3231_VIRT_MINUTES];
-  cascade = ds3231_virt_tick_bcd_reg(&reg);
-  if (!cascade) return;
-
-  /*
-   * Hours
-   */
-  reg.reg = &p->nvram[DS3231_VIRT_HOURS];
-  if (ds3231_get_flag(p->nvram[DS3231_VIRT_HOURS], DS3231_VIRT_12_24_HR)) {
-    // 12 hour mode
-    reg.min_val = 1;
-    reg.max_val = 12;
-    reg.tens_mask = 0b00010000;
-    uint8_t pm = ds3231_get_flag(p->nvram[DS3231_VIRT_HOURS], DS3231_VIRT_AM_PM);
-    cascade = ds3231_virt_tick_bcd_reg(&reg);
-    if (cascade) {
-      if (pm) {
-        // Switch to AM
-        p->nvram[DS3231_VIRT_HOURS] &= ~(1 << DS3231_VIRT_AM_PM);
-      } else {
-        // Switch to PM and catch the cascade
-        p->nvram[DS3231_VIRT_HOURS] |= (1 << DS3231_VIRT_AM_PM);
-        cascade = 0;
-      }
-    }
-  } else {
-    // 24 hour mode
-    reg.min_val = 0;
-    reg.max_val = 23;
-    reg.tens_mask = 0b00110000;
-    cascade = ds3231_virt_tick_bcd_reg(&reg);
-  }
-  if (!cascade) return;
-
+static void ds3231_virt_tick_date(ds3231_virt_t *p) {
   /*
    * Day
    */
-  reg.reg = &p->nvram[DS3231_VIRT_DAY];
-  reg.min_val = 1;
-  reg.max_val = 7;
-  reg.tens_mask = 0;
+  bcd_reg_t reg = {
+      .reg = &p->nvram[DS3231_VIRT_DAY], .min_val = 1, .max_val = 7, .tens_mask = 0};
   ds3231_virt_tick_bcd_reg(&reg);
 
   /*
@@ -252,7 +212,7 @@ static void ds3231_virt_tick_time(ds3231_virt_t *p) {
   uint16_t year = 2000 + UNPACK_BCD(p->nvram[DS3231_VIRT_YEAR]);
   reg.max_val = ds3231_virt_days_in_month(UNPACK_BCD(p->nvram[DS3231_VIRT_MONTH]), year);
   reg.tens_mask = 0b00110000;
-  cascade = ds3231_virt_tick_bcd_reg(&reg);
+  uint8_t cascade = ds3231_virt_tick_bcd_reg(&reg);
   if (!cascade) return;
 
   /*
@@ -271,7 +231,46 @@ static void ds3231_virt_tick_time(ds3231_virt_t *p) {
   reg.min_val = 0;
   reg.max_val = 99;
   reg.tens_mask = 0b11110000;
-  cascade = ds3231_virt_tick_bcd_reg(&reg);
+  ds3231_virt_tick_bcd_reg(&reg);
+}
+
+/*
+ * Advances the time registers by a number of seconds, cascading into the
+ * date registers once for every midnight passed. The time of day is done
+ * arithmetically so a long gap costs one step per day, not per second.
+ */
+static void ds3231_virt_advance_time(ds3231_virt_t *p, uint64_t seconds) {
+  uint8_t hours_reg = p->nvram[DS3231_VIRT_HOURS];
+  uint8_t twelve_hour = ds3231_get_flag(hours_reg, DS3231_VIRT_12_24_HR);
+
+  uint64_t hours;
+  if (twelve_hour) {
+    // 12 o'clock is hour 0 of its half of the day
+    hours = ((hours_reg & 0xF) + ((hours_reg & 0b00010000) >> 4) * 10) % 12;
+    if (ds3231_get_flag(hours_reg, DS3231_VIRT_AM_PM)) hours += 12;
+  } else {
+    hours = (hours_reg & 0xF) + ((hours_reg & 0b00110000) >> 4) * 10;
+  }
+
+  uint64_t time_of_day = hours * 3600 + UNPACK_BCD(p->nvram[DS3231_VIRT_MINUTES] & 0x7F) * 60 +
+                         UNPACK_BCD(p->nvram[DS3231_VIRT_SECONDS] & 0x7F) + seconds;
+  uint64_t days = time_of_day / DS3231_SECONDS_PER_DAY;
+  time_of_day %= DS3231_SECONDS_PER_DAY;
+
+  p->nvram[DS3231_VIRT_SECONDS] = PACK_BCD(time_of_day % 60);
+  p->nvram[DS3231_VIRT_MINUTES] = PACK_BCD(time_of_day / 60 % 60);
+  hours = time_of_day / 3600;
+  if (twelve_hour) {
+    uint8_t pm = hours >= 12;
+    hours %= 12;
+    if (hours == 0) hours = 12;
+    p->nvram[DS3231_VIRT_HOURS] =
+        (1 << DS3231_VIRT_12_24_HR) | (pm << DS3231_VIRT_AM_PM) | PACK_BCD(hours);
+  } else {
+    p->nvram[DS3231_VIRT_HOURS] = PACK_BCD(hours);
+  }
+
+  while (days--) ds3231_virt_tick_date(p);
 }
 
 static void ds3231_virt_cycle_square_wave(ds3231_virt_t *p) {
@@ -312,75 +311,117 @@ static void ds3231_print_time(ds3231_virt_t *p) {
   uint8_t year = (p->nvram[DS3231_VIRT_YEAR] & 0xF) + (p->nvram[DS3231_VIRT_YEAR] >> 4) * 10;
 
   if (p->verbose)
-    sim_debug_log("Time: %02i:%02i:%02i  Day: %i Date: %02i:%02i:%02i PM:%01x\n", hours, minutes,
-                  seconds, day, date, month, year, pm);
+    sim_debug_log(p->avr, "Time: %02i:%02i:%02i  Day: %i Date: %02i:%02i:%02i PM:%01x\n", hours,
+                  minutes, seconds, day, date, month, year, pm);
+}
+
+/*
+ * Lazy mode: bring the time registers up to date with the AVR cycle counter.
+ * Whole seconds are folded into the registers and the remainder stays in
+ * epoch_cycle, so the phase of the seconds counter survives between syncs.
+ */
+static void ds3231_virt_sync_time(ds3231_virt_t *p) {
+  if (!p->lazy || p->avr->frequency == 0) return;
+
+  if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_EOSC)) {
+    // Oscillator stopped, time stands still
+    p->epoch_cycle = p->avr->cycle;
+    return;
+  }
+
+  uint64_t seconds = (p->avr->cycle - p->epoch_cycle) / p->avr->frequency;
+  if (seconds) {
+    p->epoch_cycle += seconds * p->avr->frequency;
+    ds3231_virt_advance_time(p, seconds);
+    if (p->verbose) ds3231_print_time(p);
+  }
 }
 
-static avr_cycle_count_t ds3231_virt_clock_tick(struct avr_t *avr, avr_cycle_count_t when,
-                                                void *pr) {
+/*
+ * Keeps time once a second in the default mode; lazy mode needs no tick.
+ * Ticks come from the AVR's shared one second ticker, so they fall on whole
+ * seconds of AVR time.
+ */
+static bool ds3231_virt_clock_tick(void *pr, avr_cycle_count_t when) {
   ds3231_virt_t *p = (ds3231_virt_t *)pr;
-  avr_cycle_count_t next_tick = when + avr_usec_to_cycles(avr, DS3231_CLK_PERIOD_US / 2);
+  p->callback_count++;
 
-  if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_EOSC) == 0) {
-    // Oscillator is enabled. Note that this counter is allowed to wrap.
-    p->rtc++;
-  } else {
-    // Avoid a condition match below with the clock switched off
-    return next_tick;
+  if (p->lazy) {
+    return false;
   }
 
-  /*
-   * Update the time
-   */
-  if (p->rtc == 0) {
-    // 1 second has passed
-    ds3231_virt_tick_time(p);
+  if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_EOSC) == 0) {
+    // Oscillator is enabled, 1 second has passed
+    ds3231_virt_advance_time(p, 1);
     if (p->verbose) ds3231_print_time(p);
   }
 
-  /*
-   * Deal with the square wave output if enabled
-   */
-  if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_INTCN) == 0) {
+  return true;
+}
+
+static void ds3231_virt_schedule_tick(ds3231_virt_t *p) {
+  if (!p->lazy) {
+    p->ticks->Subscribe(SimTickService::kSecond, ds3231_virt_clock_tick, p);
+  } else {
+    p->ticks->Unsubscribe(SimTickService::kSecond, p);
+  }
+}
+
+static avr_cycle_count_t ds3231_virt_square_wave_tick(struct avr_t *avr, avr_cycle_count_t when,
+                                                      void *pr) {
+  ds3231_virt_t *p = (ds3231_virt_t *)pr;
+  p->callback_count++;
+  ds3231_virt_cycle_square_wave(p);
+  return when + p->sqw_half_period;
+}
+
+/*
+ * Arm the square wave timer at half the period selected by RS1/RS2, or stop
+ * it if the output is disabled. In lazy mode the output is only generated
+ * once it is wired up.
+ */
+static void ds3231_virt_schedule_square_wave(ds3231_virt_t *p) {
+  // Crystal divider for each prescaler mode, indexed by SqWaveFreq
+  static const uint16_t sqw_freq_divider[] = {
+      DS3231_CLK_FREQ,  // Hz1
+      32,               // Hz1024k
+      8,                // Hz4096
+      4,                // Hz8192k
+  };
+
+  avr_cycle_count_t half_period = 0;
+  if (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_EOSC) == 0 &&
+      ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_INTCN) == 0 &&
+      (p->sqw_attached || !p->lazy) && p->avr->frequency) {
     uint8_t prescaler_mode =
         ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_RS1) +
         (ds3231_get_flag(p->nvram[DS3231_VIRT_CONTROL], DS3231_CONTROL_RS2) << 1);
+    uint16_t freq = DS3231_CLK_FREQ / sqw_freq_divider[prescaler_mode];
+    half_period = avr_hz_to_cycles(p->avr, 2 * freq);
+    if (half_period == 0) half_period = 1;
+  }
 
-    switch (prescaler_mode) {
-      case Hz1:
-        if ((p->rtc + 1) % DS3231_CLK_FREQ == 0) {
-          ds3231_virt_cycle_square_wave(p);
-        }
-        break;
-      case Hz1024k:
-        if ((p->rtc + 1) % (DS3231_CLK_FREQ / 32) == 0) ds3231_virt_cycle_square_wave(p);
-        break;
-      case Hz4096:
-        if ((p->rtc + 1) % (DS3231_CLK_FREQ / 8) == 0) ds3231_virt_cycle_square_wave(p);
-        break;
-      case Hz8192k:
-        if ((p->rtc + 1) % (DS3231_CLK_FREQ / 4) == 0) ds3231_virt_cycle_square_wave(p);
-        break;
-      default:
-        sim_debug_log("DS3231 ERROR: PRESCALER MODE INVALID\n");
-        break;
-    }
+  if (half_period == p->sqw_half_period) {
+    // Nothing changed, leave the phase alone
+    return;
   }
 
-  return next_tick;
+  p->sqw_timer.Cancel();
+  p->sqw_half_period = half_period;
+  if (half_period) {
+    p->sqw_timer.ScheduleIn(half_period);
+    if (p->verbose)
+      sim_debug_log(p->avr, "DS3231 square wave half period %d cycles\n", (int)half_period);
+  }
 }
 
 static void ds3231_virt_clock_xtal_init(struct avr_t *avr, ds3231_virt_t *p) {
-  p->rtc = 0;
+  p->epoch_cycle = avr->cycle;
+  ds3231_virt_schedule_tick(p);
+  ds3231_virt_schedule_square_wave(p);
 
-  /*
-   * Set a timer for half the clock period to allow reconstruction
-   * of the square wave output at the maximum possible frequency.
-   */
-  avr_cycle_timer_register_usec(avr, DS3231_CLK_PERIOD_US / 2, ds3231_virt_clock_tick, p);
-
-  sim_debug_log("DS3231 clock crystal period %uS or %d cycles\n", DS3231_CLK_PERIOD_US,
-                (int)avr_usec_to_cycles(avr, DS3231_CLK_PERIOD_US));
+  sim_debug_log(avr, "DS3231 clock crystal frequency %dHz, 1 second is %d cycles\n",
+                DS3231_CLK_FREQ, (int)avr_hz_to_cycles(avr, 1));
 }
 
 /*
@@ -390,6 +431,7 @@ static void ds3231_virt_in_hook(struct avr_irq_t *irq, uint32_t value, void *par
   ds3231_virt_t *p = (ds3231_virt_t *)param;
   avr_twi_msg_irq_t v;
   v.u.v = value;
+  p->callback_count++;
 
   /*
    * If we receive a STOP, check it was meant to us, and reset the transaction
@@ -397,7 +439,7 @@ static void ds3231_virt_in_hook(struct avr_irq_t *irq, uint32_t value, void *par
   if (v.u.twi.msg & TWI_COND_STOP) {
     if (p->selected) {
       // Wahoo, it was us!
-      if (p->verbose) sim_debug_log("DS3231 stop\n\n");
+      if (p->verbose) sim_debug_log(p->avr, "DS3231 stop\n\n");
     }
     /* We should not zero the register address here because read mode uses the last
      * register address stored and write mode always overwrites it.
@@ -417,7 +459,9 @@ static void ds3231_virt_in_hook(struct avr_irq_t *irq, uint32_t value, void *par
     // Ignore the read write bit
     if ((v.u.twi.addr >> 1) == (DS3231_VIRT_TWI_ADDR >> 1)) {
       // it's us !
-      if (p->verbose) sim_debug_log("DS3231 start\n");
+      if (p->verbose) sim_debug_log(p->avr, "DS3231 start\n");
+      // Like the real part, latch the time into the registers at START
+      ds3231_virt_sync_time(p);
       p->selected = v.u.twi.addr;
       avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, p->selected, 1));
     }
@@ -435,13 +479,15 @@ static void ds3231_virt_in_hook(struct avr_irq_t *irq, uint32_t value, void *par
       // Write to the selected register (see p13. DS3231 datasheet for details)
       if (p->reg_selected) {
         if (p->verbose)
-          sim_debug_log("DS3231 set register 0x%02x to 0x%02x\n", p->reg_addr, v.u.twi.data);
+          sim_debug_log(p->avr, "DS3231 set register 0x%02x to 0x%02x\n", p->reg_addr,
+                        v.u.twi.data);
         p->nvram[p->reg_addr] = v.u.twi.data;
         ds3231_virt_update(p);
         ds3231_virt_incr_addr(p);
         // No register selected so select one
       } else {
-        if (p->verbose) sim_debug_log("DS3231 select register 0x%02x\n", v.u.twi.data);
+        if (p->verbose)
+          sim_debug_log(p->avr, "DS3231 select register 0x%02x\n", v.u.twi.data);
         p->reg_selected = 1;
         p->reg_addr = v.u.twi.data;
       }
@@ -449,7 +495,8 @@ static void ds3231_virt_in_hook(struct avr_irq_t *irq, uint32_t value, void *par
     // Read transaction
     if (v.u.twi.msg & TWI_COND_READ) {
       if (p->verbose)
-        sim_debug_log("DS3231 READ data at 0x%02x: 0x%02x\n", p->reg_addr, p->nvram[p->reg_addr]);
+        sim_debug_log(p->avr, "DS3231 READ data at 0x%02x: 0x%02x\n", p->reg_addr,
+                      p->nvram[p->reg_addr]);
       uint8_t data = p->nvram[p->reg_addr];
       ds3231_virt_incr_addr(p);
       avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, p->selected, data));
@@ -467,12 +514,24 @@ static const char *_ds3231_irq_names[DS3231_IRQ_COUNT] = {
  * Initialise the DS3231 virtual part. This should be called before anything else.
  */
 void ds3231_virt_init(struct avr_t *avr, ds3231_virt_t *p) {
-  memset(p, 0, sizeof(*p));
+  p->verbose = 0;
+  p->selected = 0;
+  p->reg_selected = 0;
+  p->reg_addr = 0;
   memset(p->nvram, 0x00, sizeof(p->nvram));
   // Default for day counter. Strangely it runs from 1-7.
   p->nvram[DS3231_VIRT_DAY] = 1;
+  p->square_wave = 0;
+  p->lazy = 0;
+  p->sqw_attached = 0;
+  p->sqw_half_period = 0;
+  p->callback_count = 0;
 
   p->avr = avr;
+  p->ticks = SimTickService::Get(avr);
+  p->sqw_timer.Bind(avr, [p](avr_cycle_count_t when) {
+    return ds3231_virt_square_wave_tick(p->avr, when, p);
+  });
 
   p->irq = avr_alloc_irq(&avr->irq_pool, 0, DS3231_IRQ_COUNT, _ds3231_irq_names);
   avr_irq_register_notify(p->irq + TWI_IRQ_OUTPUT, ds3231_virt_in_hook, p);
@@ -481,9 +540,44 @@ void ds3231_virt_init(struct avr_t *avr, ds3231_virt_t *p) {
 }
 
 void ds3231_virt_free(ds3231_virt_t *p) {
+  p->ticks->Unsubscribe(SimTickService::kSecond, p);
+  p->ticks.reset();
+  p->sqw_timer.Reset();
   avr_free_irq(p->irq, DS3231_IRQ_COUNT);
 }
 
+void ds3231_virt_save(ds3231_virt_t *p, ds3231_virt_state_t *s) {
+  s->selected = p->selected;
+  s->reg_selected = p->reg_selected;
+  s->reg_addr = p->reg_addr;
+  memcpy(s->nvram, p->nvram, sizeof(s->nvram));
+  s->square_wave = p->square_wave;
+  s->sqw_irq_value = p->irq[DS3231_SQW_IRQ_OUT].value;
+  s->sqw_half_period = p->sqw_half_period;
+  s->epoch_cycle = p->epoch_cycle;
+}
+
+void ds3231_virt_restore(ds3231_virt_t *p, const ds3231_virt_state_t *s) {
+  p->selected = s->selected;
+  p->reg_selected = s->reg_selected;
+  p->reg_addr = s->reg_addr;
+  memcpy(p->nvram, s->nvram, sizeof(p->nvram));
+  p->square_wave = s->square_wave;
+  p->irq[DS3231_SQW_IRQ_OUT].value = s->sqw_irq_value;
+  p->sqw_half_period = s->sqw_half_period;
+  p->epoch_cycle = s->epoch_cycle;
+  // Also brings the ticker back onto the restored clock.
+  ds3231_virt_schedule_tick(p);
+}
+
+void ds3231_virt_set_lazy(ds3231_virt_t *p, int lazy) {
+  ds3231_virt_sync_time(p);
+  p->lazy = lazy != 0;
+  p->epoch_cycle = p->avr->cycle;
+  ds3231_virt_schedule_tick(p);
+  ds3231_virt_schedule_square_wave(p);
+}
+
 /*
  *  "Connect" the IRQs of the DS3231 to the TWI/i2c master of the AVR.
  */
@@ -498,4 +592,6 @@ void ds3231_virt_attach_twi(ds3231_virt_t *p, uint32_t i2c_irq_base) {
 void ds3231_virt_attach_square_wave_output(ds3231_virt_t *p, ds3231_pin_t *wiring) {
   avr_connect_irq(p->irq + DS3231_SQW_IRQ_OUT,
                   avr_io_getirq(p->avr, AVR_IOCTL_IOPORT_GETIRQ(wiring->port), wiring->pin));
+  p->sqw_attached = 1;
+  ds3231_virt_schedule_square_wave(p);
 }
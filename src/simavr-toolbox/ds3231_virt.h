@@ -29,6 +29,7 @@
  *  Features:
  *
  *  > External oscillator is synced to the AVR core
+ *  > Optional lazy timekeeping derived from the AVR cycle counter
  *  > Square wave output with scalable frequency
  *  > Leap year correction until 2100
  *
@@ -38,6 +39,10 @@
 #ifndef DS3231_VIRT_H_
 #define DS3231_VIRT_H_
 
+#include <memory>
+#include <simavr-toolbox/sim_tick_service.hpp>
+#include <simavr-toolbox/timer.hpp>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -65,14 +70,41 @@ typedef struct ds3231_virt_t {
   uint8_t reg_selected;  // register selected for write
   uint8_t reg_addr;      // register pointer
   uint8_t nvram[64];     // battery backed up NVRAM
-  uint16_t rtc;          // RTC counter
   uint8_t square_wave;
+  uint8_t lazy;                       // time derived from avr->cycle rather than a timer tick
+  uint8_t sqw_attached;               // square wave output is wired to the AVR
+  avr_cycle_count_t sqw_half_period;  // square wave timer period, 0 when disabled
+  avr_cycle_count_t epoch_cycle;      // lazy mode: cycle at which nvram held the current time
+  uint64_t callback_count;            // TWI notifications and clock ticks handled
+  std::shared_ptr<SimTickService> ticks;  // 1 second clock tick, subscribed unless lazy
+  SimTimer sqw_timer;                 // square wave edges, pending while sqw_half_period is set
 } ds3231_virt_t;
 
+// The part of a ds3231_virt_t that changes while the simulation runs, for board snapshots. The
+// square wave timer is not in it; save it alongside with SimSaveTimer(). The clock tick needs no
+// saving, as it falls on whole seconds of AVR time.
+typedef struct ds3231_virt_state_t {
+  uint8_t selected;
+  uint8_t reg_selected;
+  uint8_t reg_addr;
+  uint8_t nvram[64];
+  uint8_t square_wave;
+  uint32_t sqw_irq_value;
+  avr_cycle_count_t sqw_half_period;
+  avr_cycle_count_t epoch_cycle;
+} ds3231_virt_state_t;
+
 void ds3231_virt_init(struct avr_t* avr, ds3231_virt_t* p);
 
 void ds3231_virt_free(ds3231_virt_t* p);
 
+/*
+ * In lazy mode the time registers are not ticked. Instead the time is worked out from the
+ * AVR cycle count whenever the firmware reads or writes the clock, and no timer runs at all
+ * unless the square wave output is enabled and attached.
+ */
+void ds3231_virt_set_lazy(ds3231_virt_t* p, int lazy);
+
 /*
  * Attach the ds3231 to the AVR's TWI master code,
  * pass AVR_IOCTL_TWI_GETIRQ(0) for example as i2c_irq_base
@@ -81,6 +113,12 @@ void ds3231_virt_attach_twi(ds3231_virt_t* p, uint32_t i2c_irq_base);
 
 void ds3231_virt_attach_square_wave_output(ds3231_virt_t* p, ds3231_pin_t* wiring);
 
+void ds3231_virt_save(ds3231_virt_t* p, ds3231_virt_state_t* s);
+
+// Put back a state saved from this part, or from one set up the same way on an AVR that has been
+// restored to the same cycle.
+void ds3231_virt_restore(ds3231_virt_t* p, const ds3231_virt_state_t* s);
+
 #ifdef __cplusplus
 }
 #endif
@@ -127,7 +127,7 @@ static uint32_t hd44780_write_data(hd44780_t *b) {
   b->vram[b->cursor] = b->datapins;
 
   if (b->verbose) {
-    sim_debug_log("hd44780_write_data %02x\n", b->datapins);
+    sim_debug_log(b->avr, "hd44780_write_data %02x\n", b->datapins);
   }
 
   if (hd44780_get_flag(b, HD44780_FLAG_S_C)) {  // display shift ?
@@ -153,7 +153,7 @@ static uint32_t hd44780_write_command(hd44780_t *b) {
       top--;
 
   if (b->verbose) {
-    sim_debug_log("hd44780_write_command %02x\n", b->datapins);
+    sim_debug_log(b->avr, "hd44780_write_command %02x\n", b->datapins);
   }
 
   switch (top) {
@@ -185,7 +185,7 @@ static uint32_t hd44780_write_command(hd44780_t *b) {
       hd44780_set_flag(b, HD44780_FLAG_F, b->datapins & 4);
       if (!four && !hd44780_get_flag(b, HD44780_FLAG_D_L)) {
         if (b->verbose) {
-          sim_debug_log("%s activating 4 bits mode\n", __FUNCTION__);
+          sim_debug_log(b->avr, "%s activating 4 bits mode\n", __FUNCTION__);
         }
         hd44780_set_flag(b, HD44780_FLAG_LOWNIBBLE, 0);
       }
@@ -245,7 +245,8 @@ static uint32_t hd44780_process_write(hd44780_t *b) {
   // write has 8 bits to process
   if (write) {
     if (hd44780_get_flag(b, HD44780_FLAG_BUSY)) {
-      sim_debug_log("%s command %02x write when still BUSY\n", __FUNCTION__, b->datapins);
+      sim_log(b->avr, SimLogLevel::Warning, "%s command %02x write when still BUSY\n", __FUNCTION__,
+              b->datapins);
     }
     if (b->pinstate & (1 << IRQ_HD44780_RS))  // write data
       delay = hd44780_write_data(b);
@@ -287,7 +288,7 @@ static uint32_t hd44780_process_read(hd44780_t *b) {
       // the timer too
       hd44780_set_flag(b, HD44780_FLAG_BUSY, 0);
       avr_raise_irq(b->irq + IRQ_HD44780_BUSY, 0);
-      avr_cycle_timer_cancel(b->avr, _hd44780_busy_timer, b);
+      b->busy_timer.Cancel();
     }
     avr_raise_irq(b->irq + IRQ_HD44780_DATA_OUT, b->readpins);
 
@@ -312,7 +313,7 @@ static avr_cycle_count_t _hd44780_process_e_pinchange(struct avr_t *avr, avr_cyc
 
 #if 0
 	uint16_t touch = b->oldstate ^ b->pinstate;
-	sim_debug_log("LCD: %04x %04x %c %c %c %c\n", b->pinstate, touch,
+	sim_debug_log(b->avr, "LCD: %04x %04x %c %c %c %c\n", b->pinstate, touch,
 			b->pinstate & (1 << IRQ_HD44780_RW) ? 'R' : 'W',
 			b->pinstate & (1 << IRQ_HD44780_RS) ? 'D' : 'C',
 			hd44780_get_flag(b, HD44780_FLAG_LOWNIBBLE) ? 'L' : 'H',
@@ -328,7 +329,7 @@ static avr_cycle_count_t _hd44780_process_e_pinchange(struct avr_t *avr, avr_cyc
   if (delay) {
     hd44780_set_flag(b, HD44780_FLAG_BUSY, 1);
     avr_raise_irq(b->irq + IRQ_HD44780_BUSY, 1);
-    avr_cycle_timer_register_usec(b->avr, delay, _hd44780_busy_timer, b);
+    b->busy_timer.ScheduleInUsec(delay);
   }
   //	b->oldstate = b->pinstate;
   hd44780_set_flag(b, HD44780_FLAG_REENTRANT, 0);
@@ -361,7 +362,7 @@ static void hd44780_pin_changed_hook(struct avr_irq_t *irq, uint32_t value, void
   int eo = old & (1 << IRQ_HD44780_E);
   int e = b->pinstate & (1 << IRQ_HD44780_E);
   // on the E pin rising edge, do stuff otherwise just exit
-  if (!eo && e) avr_cycle_timer_register(b->avr, 1, _hd44780_process_e_pinchange, b);
+  if (!eo && e) b->e_timer.ScheduleIn(1);
 }
 
 static const char *irq_names[IRQ_HD44780_COUNT] = {
@@ -385,11 +386,21 @@ static const char *irq_names[IRQ_HD44780_COUNT] = {
 };
 
 void hd44780_init(struct avr_t *avr, struct hd44780_t *b, int width, int height) {
-  memset(b, 0, sizeof(*b));
   b->avr = avr;
   b->w = width;
   b->h = height;
+  memset(b->vram, 0, sizeof(b->vram));
+  b->pinstate = 0;
+  b->datapins = 0;
+  b->readpins = 0;
+  b->flags = 0;
   b->verbose = false;
+  b->busy_timer.Bind(avr, [b](avr_cycle_count_t when) {
+    return _hd44780_busy_timer(b->avr, when, b);
+  });
+  b->e_timer.Bind(avr, [b](avr_cycle_count_t when) {
+    return _hd44780_process_e_pinchange(b->avr, when, b);
+  });
   /*
    * Register callbacks on all our IRQs
    */
@@ -400,10 +411,34 @@ void hd44780_init(struct avr_t *avr, struct hd44780_t *b, int width, int height)
   _hd44780_reset_cursor(b);
   _hd44780_clear_screen(b);
 
-  sim_debug_log("LCD: %duS is %d cycles for your AVR\n", 37, (int)avr_usec_to_cycles(avr, 37));
-  sim_debug_log("LCD: %duS is %d cycles for your AVR\n", 1, (int)avr_usec_to_cycles(avr, 1));
+  sim_debug_log(avr, "LCD: %duS is %d cycles for your AVR\n", 37,
+                (int)avr_usec_to_cycles(avr, 37));
+  sim_debug_log(avr, "LCD: %duS is %d cycles for your AVR\n", 1, (int)avr_usec_to_cycles(avr, 1));
+}
+
+void hd44780_save(struct hd44780_t *b, hd44780_state_t *s) {
+  s->cursor = b->cursor;
+  memcpy(s->vram, b->vram, sizeof(s->vram));
+  s->pinstate = b->pinstate;
+  s->datapins = b->datapins;
+  s->readpins = b->readpins;
+  s->flags = b->flags;
+  s->data_out_value = b->irq[IRQ_HD44780_DATA_OUT].value;
+}
+
+void hd44780_restore(struct hd44780_t *b, const hd44780_state_t *s) {
+  b->cursor = s->cursor;
+  memcpy(b->vram, s->vram, sizeof(b->vram));
+  b->pinstate = s->pinstate;
+  b->datapins = s->datapins;
+  b->readpins = s->readpins;
+  // Whatever was on screen before may be gone now.
+  b->flags = s->flags | (1 << HD44780_FLAG_DIRTY);
+  b->irq[IRQ_HD44780_DATA_OUT].value = s->data_out_value;
 }
 
 void hd44780_free(struct hd44780_t *b) {
+  b->busy_timer.Reset();
+  b->e_timer.Reset();
   avr_free_irq(b->irq, IRQ_HD44780_COUNT);
 }
\ No newline at end of file
@@ -48,11 +48,13 @@
 #ifndef __HD44780_H__
 #define __HD44780_H__
 
+#include <simavr-toolbox/timer.hpp>
 #include <string>
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#include "sim_avr_types.h"
 #include "sim_irq.h"
 
 enum {
@@ -116,12 +118,30 @@ typedef struct hd44780_t {
 
   uint16_t flags;  // LCD flags ( HD44780_FLAG_*)
   bool verbose;
+
+  SimTimer busy_timer;  // clears BUSY once the last instruction has had its time
+  SimTimer e_timer;     // runs the instruction latched on the E rising edge
 } hd44780_t;
 
+// The part of a hd44780_t that changes while the simulation runs, for board snapshots. The timers
+// are not in it; save them alongside with SimSaveTimer().
+typedef struct hd44780_state_t {
+  uint16_t cursor;
+  uint8_t vram[0x80 + 0x40];
+  uint16_t pinstate;
+  uint8_t datapins;
+  uint8_t readpins;
+  uint16_t flags;
+  uint32_t data_out_value;
+} hd44780_state_t;
+
 void hd44780_init(struct avr_t *avr, struct hd44780_t *b, int width, int height);
 void hd44780_free(struct hd44780_t *b);
 void hd44780_print(struct hd44780_t *b, std::string &s);
 
+void hd44780_save(struct hd44780_t *b, hd44780_state_t *s);
+void hd44780_restore(struct hd44780_t *b, const hd44780_state_t *s);
+
 static inline int hd44780_set_flag(hd44780_t *b, uint16_t bit, int val) {
   int old = b->flags & (1 << bit);
   b->flags = (b->flags & ~(1 << bit)) | (val ? (1 << bit) : 0);
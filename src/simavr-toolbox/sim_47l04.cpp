@@ -4,9 +4,9 @@
 
 #include <cstdint>
 #include <string>
-#include <thread>
 
 #include "avr_twi.h"
+#include "sim_time.h"
 
 // 24LCXX control code.
 constexpr uint8_t kControlCode = 0b1010'0000;
@@ -28,10 +28,6 @@ std::string GetMessageType(const avr_twi_msg_t& message) {
   return str;
 }
 
-bool IsControlByte(const avr_twi_msg_t& message) {
-  return message.addr & kControlCode;
-}
-
 uint8_t MakeAddress(bool a2, bool a1) {
   uint8_t mask = (a2 << 1) | (a1);
   mask <<= 2;
@@ -39,66 +35,63 @@ uint8_t MakeAddress(bool a2, bool a1) {
   return item;
 }
 
-Sim47LXX::Sim47LXX(avr_t* avr, bool a2, bool a1) : SimAvrI2CComponent(avr, MakeAddress(a2, a1)) {
-  ResetStateMachine();
-}
-
-void Sim47LXX::HandleI2CMessage(const avr_twi_msg_t& message) {
-  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+Sim47LXX::Sim47LXX(avr_t* avr, bool a2, bool a1, avr_cycle_count_t write_cycle_time)
+    : SimAvrI2CTransactionComponent(avr, MakeAddress(a2, a1)),
+      write_cycle_time_(write_cycle_time ? write_cycle_time
+                                         : avr_usec_to_cycles(avr, kWriteCycleTimeUsec)) {}
 
-  if (message.msg & TWI_COND_STOP) {
-    state_ = STOPPED;
-    ResetStateMachine();
-  } else if (message.msg & TWI_COND_START) {
-    if (!IsControlByte(message)) {
-      // This should never be invoked in the threeboard code.
-      return;
-    }
+bool Sim47LXX::IsBusy() const {
+  return Avr_->cycle < busy_until_;
+}
 
-    // ACK the start message, parse out the read/write flag, and prepare to
-    // receive the two address bytes.
-    mode_ = static_cast<I2CMode>(message.addr & 1);
+void Sim47LXX::SaveState(SimStateWriter& out) const {
+  SimAvrI2CTransactionComponent::SaveState(out);
+  out.Write(buffer_);
+  out.Write(operation_address_);
+  out.Write(operation_address_counter_);
+  out.Write(write_pending_);
+  out.Write(busy_until_);
+}
 
-    // The address word should only be sent for write operations. Read
-    // operations are addressed first by starting a write operation and writing
-    // the address word, and then sending a repeated start to switch the device
-    // into read operation mode once it has been addressed.
-    if (mode_ == I2CMode::WRITE) {
-      state_ = ADDRESSING_HIGH;
-    } else {
-      state_ = STARTED;
-    }
+void Sim47LXX::RestoreState(SimStateReader& in) {
+  SimAvrI2CTransactionComponent::RestoreState(in);
+  in.Read(buffer_);
+  in.Read(operation_address_);
+  in.Read(operation_address_counter_);
+  in.Read(write_pending_);
+  in.Read(busy_until_);
+}
 
-    SendToAvrI2CAck();
-  } else if (message.msg & TWI_COND_WRITE) {
-    // Ack the message.
-    SendToAvrI2CAck();
+bool Sim47LXX::OnStart(bool read, bool repeated_start) {
+  // Not acknowledging the control byte is what tells the firmware to poll
+  // again.
+  return !IsBusy();
+}
 
-    // Write messages can serve one of two purposes:
-    // 1. Writing the address of the read/write operation.
-    // 2. Writing data to the EEPROM as part of an already addressed write
-    //    operation.
-    // Address writing always happens before any write occurs.
-    if (state_ == ADDRESSING_HIGH) {
-      operation_address_ |= (message.data << 8);
-      state_ = ADDRESSING_LOW;
-    } else if (state_ == ADDRESSING_LOW) {
-      operation_address_ |= message.data;
-      state_ = STARTED;
-    } else if (state_ == STARTED) {
-      buffer_.at(operation_address_ + operation_address_counter_) = message.data;
-      operation_address_counter_++;
-    }
-  } else if (message.msg & TWI_COND_READ) {
-    // Simple return of selected byte.
-    uint8_t current_byte = buffer_.at(operation_address_ + operation_address_counter_);
+void Sim47LXX::OnWrite(std::span<const uint8_t> data) {
+  operation_address_ |= data[0] << 8;
+  if (data.size() < 2) {
+    return;
+  }
+  operation_address_ |= data[1];
+  for (auto byte : data.subspan(2)) {
+    buffer_.at(operation_address_ + operation_address_counter_) = byte;
     operation_address_counter_++;
-    SendByteToAvrI2c(current_byte);
+    write_pending_ = true;
   }
 }
 
-void Sim47LXX::ResetStateMachine() {
+uint8_t Sim47LXX::OnRead() {
+  uint8_t current_byte = buffer_.at(operation_address_ + operation_address_counter_);
+  operation_address_counter_++;
+  return current_byte;
+}
+
+void Sim47LXX::OnStop() {
   operation_address_ = 0;
   operation_address_counter_ = 0;
-  state_ = STOPPED;
+  if (write_pending_) {
+    write_pending_ = false;
+    busy_until_ = Avr_->cycle + write_cycle_time_;
+  }
 }
@@ -2,47 +2,62 @@
 
 #include <array>
 #include <cstdint>
+#include <span>
 
-#include "sim_i2c_base.hpp"
+#include "sim_i2c_transaction_base.hpp"
 
 // This class represents a simulated external EEPROM communicating with the main
 // MCU via i2c.
-class Sim47LXX : public SimAvrI2CComponent {
+//
+// A write transaction is committed at STOP and keeps the device busy for the
+// write cycle time (tWC). While busy the device does not acknowledge its
+// address, so firmware can acknowledge-poll for completion as on hardware.
+class Sim47LXX : public SimAvrI2CTransactionComponent {
  public:
-  Sim47LXX(avr_t* avr, bool a0, bool a1);
+  // Datasheet maximum write cycle time.
+  static constexpr uint32_t kWriteCycleTimeUsec = 5000;
+
+  // write_cycle_time is tWC in AVR cycles; 0 uses kWriteCycleTimeUsec at the
+  // AVR's clock frequency.
+  Sim47LXX(avr_t* avr, bool a0, bool a1, avr_cycle_count_t write_cycle_time = 0);
+
+  // True while a write cycle is in progress.
+  bool IsBusy() const;
+
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
 
  private:
-  // Handle a message fragment.
-  virtual void HandleI2CMessage(const avr_twi_msg_t& msg) override;
+  // The control byte is not acknowledged during a write cycle.
+  bool OnStart(bool read, bool repeated_start) override;
+
+  // A write phase starts with the two address bytes, followed by any data to
+  // store. Reads are addressed by a write phase of just the address, ended by
+  // a repeated start.
+  void OnWrite(std::span<const uint8_t> data) override;
 
-  // Reset the state of this device.
-  virtual void ResetStateMachine() override;
+  // Simple return of the selected byte.
+  uint8_t OnRead() override;
+
+  // Reset the addressing, and start the write cycle if data was written.
+  void OnStop() override;
 
   // Storage for the data in this EEPROM.
   std::array<uint8_t, 4096> buffer_;
 
-  // The current state of the EEPROM. Since device addressing for the 22LC512
-  // takes three bytes (and therefore three messages), we need to keep track of
-  // the state of the device as it progresses through the device addressing
-  // sequence.
-  enum EepromState {
-    STOPPED,
-    ADDRESSING_HIGH,
-    ADDRESSING_LOW,
-    STARTED,
-  };
-
-  EepromState state_{EepromState::STOPPED};
-
-  // The read/write flag is sent in the control byte, and sets the mode of the
-  // device for subsequent messages. We need to persist it for the duration of
-  // the operation.
-  I2CMode mode_;
-
-  // The address of the current operation. This is only fully valid when
-  // state_ == STARTED.
+  // The address of the current operation.
   uint16_t operation_address_{0};
 
   // Maintain the address of the last word accessed.
   uint8_t operation_address_counter_{0};
+
+  // Length of a write cycle in AVR cycles.
+  avr_cycle_count_t write_cycle_time_{0};
+
+  // Set when data is written during the current transaction, so the STOP that
+  // ends it starts a write cycle.
+  bool write_pending_{false};
+
+  // The AVR cycle at which the current write cycle completes.
+  avr_cycle_count_t busy_until_{0};
 };
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Returns the instance of T shared by everything attached to avr, constructing it as T(avr) on
+// first use. The instance lives for as long as somebody holds on to it, so holders must release
+// it before the avr is terminated.
+template <typename T>
+std::shared_ptr<T> GetPerAvrInstance(avr_t* avr) {
+  static std::mutex mutex;
+  static std::map<avr_t*, std::weak_ptr<T>> instances;
+
+  std::lock_guard lock(mutex);
+  auto instance = instances[avr].lock();
+  if (!instance) {
+    // Drop entries left behind by avrs that have gone away.
+    std::erase_if(instances, [](const auto& entry) { return entry.second.expired(); });
+    instance = std::make_shared<T>(avr);
+    instances[avr] = instance;
+  }
+  return instance;
+}
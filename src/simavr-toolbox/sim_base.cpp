@@ -1,6 +1,8 @@
 #include "sim_base.hpp"
 
+#include <atomic>
 #include <cstdarg>
+#include <simavr-toolbox/sim_log_context.hpp>
 
 /*
 
@@ -26,19 +28,51 @@ void set_sim_debug_log(DebugLogFn<Args...> fn) {
 
 void empty_log(const char*, va_list) {}
 
-void (*gDebugLogFn)(const char*, va_list) = empty_log;
+// Boards may run on several threads at once; the function itself must then be thread-safe.
+std::atomic<DebugLogFn> gDebugLogFn = empty_log;
 
 void sim_debug_log(const char* fmt, ...) {
   va_list myargs;
   va_start(myargs, fmt);
-  gDebugLogFn(fmt, myargs);
+  gDebugLogFn.load(std::memory_order_acquire)(fmt, myargs);
   va_end(myargs);
 }
 
 void sim_debug_log(std::string_view s) {
-  sim_debug_log(s.data());
+  // The view need not be terminated, and must not be taken as a format.
+  sim_debug_log("%.*s", static_cast<int>(s.size()), s.data());
 }
 
 void set_sim_debug_log(DebugLogFn fn) {
-  gDebugLogFn = fn;
-}
\ No newline at end of file
+  gDebugLogFn.store(fn, std::memory_order_release);
+}
+
+DebugLogFn get_sim_debug_log() {
+  return gDebugLogFn.load(std::memory_order_acquire);
+}
+
+void sim_vlog(avr_t* avr, SimLogLevel level, const char* fmt, va_list args) {
+  if (auto context = SimLogContext::Find(avr)) {
+    context->Log(level, fmt, args);
+  } else {
+    gDebugLogFn.load(std::memory_order_acquire)(fmt, args);
+  }
+}
+
+void sim_log(avr_t* avr, SimLogLevel level, const char* fmt, ...) {
+  va_list myargs;
+  va_start(myargs, fmt);
+  sim_vlog(avr, level, fmt, myargs);
+  va_end(myargs);
+}
+
+void sim_debug_log(avr_t* avr, const char* fmt, ...) {
+  va_list myargs;
+  va_start(myargs, fmt);
+  sim_vlog(avr, SimLogLevel::Debug, fmt, myargs);
+  va_end(myargs);
+}
+
+void sim_debug_log(avr_t* avr, std::string_view s) {
+  sim_debug_log(avr, "%.*s", static_cast<int>(s.size()), s.data());
+}
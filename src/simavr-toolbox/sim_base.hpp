@@ -2,12 +2,42 @@
 
 #include <stdarg.h>
 
+#include <cstdint>
 #include <string_view>
 
+struct avr_t;
+
 using DebugLogFn = void (*)(const char* fmt, va_list);
 
+enum class SimLogLevel : uint8_t {
+  Error,
+  Warning,
+  Info,
+  Debug,
+};
+
+constexpr uint32_t SimLogMask(SimLogLevel level) {
+  return 1u << static_cast<uint8_t>(level);
+}
+
+constexpr uint32_t kSimLogAllLevels = 0x0F;
+
+// Process-wide log function, used when nothing more specific applies.
 void sim_debug_log(const char* fmt, ...);
 
 void sim_debug_log(std::string_view s);
 
-void set_sim_debug_log(DebugLogFn fn);
\ No newline at end of file
+void set_sim_debug_log(DebugLogFn fn);
+
+DebugLogFn get_sim_debug_log();
+
+// Log on behalf of avr: through its SimLogContext when it has one, through the process-wide
+// function otherwise, or when avr is null because there is no board yet. sim_debug_log() logs at
+// SimLogLevel::Debug.
+void sim_log(avr_t* avr, SimLogLevel level, const char* fmt, ...);
+
+void sim_vlog(avr_t* avr, SimLogLevel level, const char* fmt, va_list args);
+
+void sim_debug_log(avr_t* avr, const char* fmt, ...);
+
+void sim_debug_log(avr_t* avr, std::string_view s);
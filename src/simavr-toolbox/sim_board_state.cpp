@@ -0,0 +1,261 @@
+#include "sim_board_state.hpp"
+
+#include <simavr/avr_eeprom.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <simavr-toolbox/ds3231_virt.h>
+#include <simavr-toolbox/hd44780.h>
+#include <simavr-toolbox/sim_base.hpp>
+
+namespace {
+
+class Ds3231State : public SimStateful {
+ public:
+  explicit Ds3231State(ds3231_virt_t* rtc) : Rtc_(rtc) {}
+
+  void SaveState(SimStateWriter& out) const override {
+    ds3231_virt_state_t state;
+    ds3231_virt_save(Rtc_, &state);
+    out.Write(state);
+    SimSaveTimer(out, Rtc_->sqw_timer);
+  }
+
+  void RestoreState(SimStateReader& in) override {
+    auto state = in.Read<ds3231_virt_state_t>();
+    ds3231_virt_restore(Rtc_, &state);
+    SimRestoreTimer(in, Rtc_->sqw_timer);
+  }
+
+ private:
+  ds3231_virt_t* Rtc_;
+};
+
+class Hd44780State : public SimStateful {
+ public:
+  explicit Hd44780State(hd44780_t* lcd) : Lcd_(lcd) {}
+
+  void SaveState(SimStateWriter& out) const override {
+    hd44780_state_t state;
+    hd44780_save(Lcd_, &state);
+    out.Write(state);
+    SimSaveTimer(out, Lcd_->busy_timer);
+    SimSaveTimer(out, Lcd_->e_timer);
+  }
+
+  void RestoreState(SimStateReader& in) override {
+    auto state = in.Read<hd44780_state_t>();
+    hd44780_restore(Lcd_, &state);
+    SimRestoreTimer(in, Lcd_->busy_timer);
+    SimRestoreTimer(in, Lcd_->e_timer);
+  }
+
+ private:
+  hd44780_t* Lcd_;
+};
+
+// The interrupt table points at vectors owned by the I/O modules, so its entries are saved by their
+// index in interrupts.vector[] and restored to the same vector of whichever board reads them.
+constexpr uint8_t kNoVector = 0xFF;
+constexpr uint8_t kResetVector = 0xFE;
+
+uint8_t VectorIndex(const avr_int_table_t& interrupts, const avr_int_vector_t* vector) {
+  if (vector == &interrupts.reset_vector) {
+    return kResetVector;
+  }
+  for (int i = 0; i < interrupts.vector_count; ++i) {
+    if (interrupts.vector[i] == vector) {
+      return i;
+    }
+  }
+  return kNoVector;
+}
+
+avr_int_vector_t* VectorAt(avr_t* avr, uint8_t index) {
+  auto& interrupts = avr->interrupts;
+  if (index == kNoVector) {
+    return nullptr;
+  }
+  if (index == kResetVector) {
+    return &interrupts.reset_vector;
+  }
+  if (index >= interrupts.vector_count) {
+    sim_log(avr, SimLogLevel::Error, "Snapshot refers to interrupt vector %d of %d\n", index,
+            interrupts.vector_count);
+    std::abort();
+  }
+  return interrupts.vector[index];
+}
+
+}  // namespace
+
+SimBoardState::SimBoardState(avr_t* avr) : Avr_(avr), Wheel_(SimTimerWheel::Get(avr)) {}
+
+SimBoardState::~SimBoardState() = default;
+
+void SimBoardState::Add(SimStateful& peripheral) {
+  Peripherals_.push_back(&peripheral);
+}
+
+void SimBoardState::Add(ds3231_virt_t* rtc) {
+  Adapters_.push_back(std::make_unique<Ds3231State>(rtc));
+  Add(*Adapters_.back());
+}
+
+void SimBoardState::Add(hd44780_t* lcd) {
+  Adapters_.push_back(std::make_unique<Hd44780State>(lcd));
+  Add(*Adapters_.back());
+}
+
+SimBoardState::Snapshot SimBoardState::Save() const {
+  Snapshot snapshot;
+  snapshot.Avr = Avr_;
+  snapshot.Cycle = Avr_->cycle;
+
+  SimStateWriter core(snapshot.Core);
+  SaveCore(core);
+
+  snapshot.TimerPool.resize(sizeof(Avr_->cycle_timers));
+  std::memcpy(snapshot.TimerPool.data(), &Avr_->cycle_timers, sizeof(Avr_->cycle_timers));
+
+  snapshot.Peripherals.reserve(Peripherals_.size());
+  for (auto* peripheral : Peripherals_) {
+    SimStateWriter out(snapshot.Peripherals.emplace_back());
+    peripheral->SaveState(out);
+  }
+  return snapshot;
+}
+
+void SimBoardState::Restore(const Snapshot& snapshot) {
+  if (snapshot.Peripherals.size() != Peripherals_.size()) {
+    sim_log(Avr_, SimLogLevel::Error, "Snapshot has %zu peripherals, board has %zu\n",
+            snapshot.Peripherals.size(), Peripherals_.size());
+    std::abort();
+  }
+
+  SimStateReader core(snapshot.Core, Avr_);
+  RestoreCore(core);
+
+  // The saved timer list refers to this board's I/O modules and peripherals; another board's
+  // would not, so a fork keeps its own and lets the peripherals re-arm theirs below.
+  if (snapshot.Avr == Avr_) {
+    std::memcpy(&Avr_->cycle_timers, snapshot.TimerPool.data(), sizeof(Avr_->cycle_timers));
+  }
+  Wheel_->Rebase();
+
+  for (size_t i = 0; i < Peripherals_.size(); ++i) {
+    SimStateReader in(snapshot.Peripherals[i], Avr_);
+    Peripherals_[i]->RestoreState(in);
+    if (!in.AtEnd()) {
+      sim_log(Avr_, SimLogLevel::Error, "Snapshot of peripheral %zu has bytes left over\n", i);
+      std::abort();
+    }
+  }
+}
+
+void SimBoardState::ForkInto(SimBoardState& other) const {
+  other.Restore(Save());
+}
+
+void SimBoardState::SaveCore(SimStateWriter& out) const {
+  out.Write(Avr_->ramend);
+  out.Write(Avr_->e2end);
+
+  out.Write(Avr_->data, Avr_->ramend + 1);
+  out.Write(Avr_->sreg);
+  out.Write(Avr_->pc);
+  out.Write(Avr_->cycle);
+  out.Write(Avr_->run_cycle_count);
+  out.Write(Avr_->run_cycle_limit);
+  out.Write(Avr_->state);
+  out.Write(Avr_->interrupt_state);
+
+  // An AVR without an EEPROM module has nothing to save.
+  std::vector<uint8_t> eeprom(Avr_->e2end ? Avr_->e2end + 1 : 0);
+  avr_eeprom_desc_t desc{eeprom.data(), 0, static_cast<uint32_t>(eeprom.size())};
+  bool hasEeprom = !eeprom.empty() && avr_ioctl(Avr_, AVR_IOCTL_EEPROM_GET, &desc) == 0;
+  out.Write(hasEeprom);
+  if (hasEeprom) {
+    out.WriteVector(eeprom);
+  }
+
+  auto& interrupts = Avr_->interrupts;
+  out.Write(interrupts.vector_count);
+  for (int i = 0; i < interrupts.vector_count; ++i) {
+    out.Write<uint8_t>(interrupts.vector[i]->pending);
+  }
+  uint16_t pendingCount = avr_int_pending_get_read_size(&interrupts.pending);
+  out.Write(pendingCount);
+  for (uint16_t i = 0; i < pendingCount; ++i) {
+    out.Write(VectorIndex(interrupts, avr_int_pending_read_at(&interrupts.pending, i)));
+  }
+  out.Write(interrupts.running_ptr);
+  for (int i = 0; i < interrupts.running_ptr; ++i) {
+    out.Write(VectorIndex(interrupts, interrupts.running[i]));
+  }
+}
+
+void SimBoardState::RestoreCore(SimStateReader& in) {
+  auto ramend = in.Read<decltype(Avr_->ramend)>();
+  auto e2end = in.Read<decltype(Avr_->e2end)>();
+  if (ramend != Avr_->ramend || e2end != Avr_->e2end) {
+    sim_log(Avr_, SimLogLevel::Error, "Snapshot of a different MCU: ramend %#x e2end %#x\n",
+            ramend, e2end);
+    std::abort();
+  }
+
+  // Read everything first so that the interrupt table is in place before the data space is, and
+  // the CPU state goes back last.
+  std::vector<uint8_t> data(Avr_->ramend + 1);
+  in.Read(data.data(), data.size());
+  decltype(Avr_->sreg) sreg;
+  in.Read(sreg);
+  auto pc = in.Read<decltype(Avr_->pc)>();
+  auto cycle = in.Read<decltype(Avr_->cycle)>();
+  auto runCycleCount = in.Read<decltype(Avr_->run_cycle_count)>();
+  auto runCycleLimit = in.Read<decltype(Avr_->run_cycle_limit)>();
+  auto state = in.Read<decltype(Avr_->state)>();
+  auto interruptState = in.Read<decltype(Avr_->interrupt_state)>();
+
+  if (in.Read<bool>()) {
+    std::vector<uint8_t> eeprom;
+    in.ReadVector(eeprom);
+    avr_eeprom_desc_t desc{eeprom.data(), 0, static_cast<uint32_t>(eeprom.size())};
+    avr_ioctl(Avr_, AVR_IOCTL_EEPROM_SET, &desc);
+  }
+
+  auto& interrupts = Avr_->interrupts;
+  auto vectorCount = in.Read<decltype(interrupts.vector_count)>();
+  if (vectorCount != interrupts.vector_count) {
+    sim_log(Avr_, SimLogLevel::Error, "Snapshot has %d interrupt vectors, board has %d\n",
+            vectorCount, interrupts.vector_count);
+    std::abort();
+  }
+  for (int i = 0; i < vectorCount; ++i) {
+    interrupts.vector[i]->pending = in.Read<uint8_t>();
+  }
+  avr_int_pending_reset(&interrupts.pending);
+  auto pendingCount = in.Read<uint16_t>();
+  for (uint16_t i = 0; i < pendingCount; ++i) {
+    avr_int_pending_write(&interrupts.pending, VectorAt(Avr_, in.Read<uint8_t>()));
+  }
+  auto runningCount = in.Read<decltype(interrupts.running_ptr)>();
+  if (runningCount > std::size(interrupts.running)) {
+    sim_log(Avr_, SimLogLevel::Error, "Snapshot has %d nested interrupts\n", runningCount);
+    std::abort();
+  }
+  interrupts.running_ptr = runningCount;
+  for (int i = 0; i < runningCount; ++i) {
+    interrupts.running[i] = VectorAt(Avr_, in.Read<uint8_t>());
+  }
+
+  std::memcpy(Avr_->data, data.data(), data.size());
+  std::memcpy(Avr_->sreg, sreg, sizeof(Avr_->sreg));
+  Avr_->pc = pc;
+  Avr_->cycle = cycle;
+  Avr_->run_cycle_count = runCycleCount;
+  Avr_->run_cycle_limit = runCycleLimit;
+  Avr_->state = state;
+  Avr_->interrupt_state = interruptState;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <cstdint>
+#include <memory>
+#include <simavr-toolbox/sim_state.hpp>
+#include <simavr-toolbox/sim_timer_wheel.hpp>
+#include <vector>
+
+struct ds3231_virt_t;
+struct hd44780_t;
+
+// Captures an AVR and the toolbox peripherals registered with it, and puts them back.
+//
+// Save() copies the data space (registers, I/O and SRAM), EEPROM, the CPU state, pending and
+// running interrupts, the cycle timer list and every registered peripheral. Restore() onto the
+// same board rewinds it exactly as far as those go. Flash is not captured, and neither is state
+// that simavr I/O modules keep outside their registers.
+//
+// Restore() onto another board forks the simulation: the other board must be built from the same
+// firmware with the same peripherals registered in the same order. Its own cycle timers are kept,
+// so timers armed by simavr I/O modules are not carried across; toolbox peripherals re-arm theirs.
+//
+// Peripherals must outlive every snapshot restored onto their board, since the saved timer list
+// refers to them. The board keeps the AVR's SimTimerWheel alive for the same reason, and rebases it
+// after every restore.
+class SimBoardState {
+ public:
+  struct Snapshot {
+    const avr_t* Avr{nullptr};
+    avr_cycle_count_t Cycle{0};
+    std::vector<uint8_t> Core;
+    std::vector<uint8_t> TimerPool;
+    std::vector<std::vector<uint8_t>> Peripherals;
+  };
+
+  explicit SimBoardState(avr_t* avr);
+  ~SimBoardState();
+  SimBoardState(const SimBoardState&) = delete;
+  SimBoardState& operator=(const SimBoardState&) = delete;
+
+  avr_t* Avr() const { return Avr_; }
+
+  void Add(SimStateful& peripheral);
+  void Add(ds3231_virt_t* rtc);
+  void Add(hd44780_t* lcd);
+
+  Snapshot Save() const;
+  void Restore(const Snapshot& snapshot);
+
+  // Copy this board's current state onto `other`.
+  void ForkInto(SimBoardState& other) const;
+
+ private:
+  void SaveCore(SimStateWriter& out) const;
+  void RestoreCore(SimStateReader& in);
+
+  avr_t* Avr_;
+  std::vector<SimStateful*> Peripherals_;
+  std::vector<std::unique_ptr<SimStateful>> Adapters_;
+  std::shared_ptr<SimTimerWheel> Wheel_;
+};
@@ -1,24 +1,18 @@
 #include "sim_bouncy_switch.hpp"
 
-#include <cstdlib>
+#include <random>
 
-#include "sim_cycle_timers.h"
 #include "sim_time.h"
 
 // =========================================================================
 
 int SimBouncySwitch::RandInt(int low, int high) {
-  return low + rand() % (high - low);
+  return std::uniform_int_distribution<int>(low, high - 1)(Rng_);
 }
 
-avr_cycle_count_t SimBouncySwitch::FakeCb(struct avr_t* avr, avr_cycle_count_t when, void* param) {
-  auto cb = (TimerCb*)param;
-  return (*cb)(when);
-}
-
-SimBouncySwitch::SimBouncySwitch(avr_t& avr, avr_irq_t& pin, bool closedValue)
-    : Avr_(avr), Pin_(pin), ClosedValue_(closedValue) {
-  BounceCb_ = std::bind(&SimBouncySwitch::OnBounce, this, std::placeholders::_1);
+SimBouncySwitch::SimBouncySwitch(avr_t& avr, avr_irq_t& pin, bool closedValue, uint32_t seed)
+    : Avr_(avr), Pin_(pin), Rng_(seed), ClosedValue_(closedValue) {
+  BounceTimer_.Bind(&avr, [this](avr_cycle_count_t when) { return OnBounce(when); });
   ChangePinValue(!closedValue);
 }
 
@@ -49,9 +43,34 @@ void SimBouncySwitch::Set(bool value) {
   RestartBounces();
 }
 
+void SimBouncySwitch::SaveState(SimStateWriter& out) const {
+  std::queue<LevelShift> shifts = PendingShifts_;
+  out.Write<uint32_t>(shifts.size());
+  for (; !shifts.empty(); shifts.pop()) {
+    out.Write(shifts.front());
+  }
+  out.Write(BouncingValue_);
+  out.Write(Rng_);
+  SimSaveIrqValue(out, &Pin_);
+  SimSaveTimer(out, BounceTimer_);
+}
+
+void SimBouncySwitch::RestoreState(SimStateReader& in) {
+  PendingShifts_ = {};
+  for (auto count = in.Read<uint32_t>(); count > 0; --count) {
+    LevelShift shift(false, ZeroMs);
+    in.Read(shift);
+    PendingShifts_.push(shift);
+  }
+  in.Read(BouncingValue_);
+  in.Read(Rng_);
+  SimRestoreIrqValue(in, &Pin_);
+  SimRestoreTimer(in, BounceTimer_);
+}
+
 void SimBouncySwitch::RestartBounces() {
   auto timeUntilFirstBounceUsec = RandInt(0, 1000);
-  avr_cycle_timer_register_usec(&Avr_, timeUntilFirstBounceUsec, &FakeCb, &BounceCb_);
+  BounceTimer_.ScheduleInUsec(timeUntilFirstBounceUsec);
 }
 
 void SimBouncySwitch::ChangePinValue(bool value) {
@@ -5,12 +5,18 @@
 
 #include <chrono>
 #include <cstdint>
-#include <functional>
 #include <queue>
+#include <random>
+#include <simavr-toolbox/sim_state.hpp>
+#include <simavr-toolbox/timer.hpp>
 
-class SimBouncySwitch {
+class SimBouncySwitch : public SimStateful {
  public:
-  SimBouncySwitch(avr_t& avr, avr_irq_t& pin, bool closedValue);
+  // Bounce timing comes from a generator owned by the switch, so a given seed gives the same
+  // bounces whatever else runs in the process.
+  static constexpr uint32_t kDefaultSeed = 1;
+
+  SimBouncySwitch(avr_t& avr, avr_irq_t& pin, bool closedValue, uint32_t seed = kDefaultSeed);
 
   void CloseForMs(std::chrono::milliseconds ms);
   void OpenForMs(std::chrono::milliseconds ms);
@@ -18,9 +24,12 @@ class SimBouncySwitch {
   void Open();
   void Set(bool value);
 
+  // Level shifts still to come, the bounce in progress and the random generator.
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
+
  private:
   static constexpr auto ZeroMs = std::chrono::milliseconds(0);
-  using TimerCb = std::function<avr_cycle_count_t(avr_cycle_count_t)>;
 
   struct LevelShift {
     LevelShift(bool targetValue, std::chrono::milliseconds holdTimeMs);
@@ -29,8 +38,7 @@ class SimBouncySwitch {
     std::chrono::microseconds HoldTimeUs_;
   };
 
-  static int RandInt(int low, int high);
-  static avr_cycle_count_t FakeCb(struct avr_t* avr, avr_cycle_count_t when, void* param);
+  int RandInt(int low, int high);
   void RestartBounces();
   void ChangePinValue(bool value);
   avr_cycle_count_t OnBounce(avr_cycle_count_t cyclesNow);
@@ -38,6 +46,7 @@ class SimBouncySwitch {
   bool BouncingValue_;
   avr_t& Avr_;
   avr_irq_t& Pin_;
-  TimerCb BounceCb_;
+  SimTimer BounceTimer_;
+  std::minstd_rand Rng_;
   const bool ClosedValue_;
 };
@@ -0,0 +1,136 @@
+#include "sim_checkpoint_ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+SimCheckpointRing::SimCheckpointRing(SimBoardState& board, const Config& config)
+    : Board_(board),
+      Config_(config),
+      IntervalCycles_(std::max<avr_cycle_count_t>(
+          1, static_cast<avr_cycle_count_t>(board.Avr()->frequency) * config.Interval.count() /
+                 1000)),
+      NextCheckpoint_(board.Avr()->cycle) {
+  Config_.PageSize = std::max<size_t>(Config_.PageSize, 1);
+}
+
+void SimCheckpointRing::Checkpoint() {
+  auto snapshot = Board_.Save();
+  const Entry* previous = Entries_.empty() ? nullptr : &Entries_.back();
+
+  Entry entry{snapshot.Avr, snapshot.Cycle, {}, {}, {}};
+  entry.Core = Store(snapshot.Core, previous ? &previous->Core : nullptr);
+  entry.TimerPool = Store(snapshot.TimerPool, previous ? &previous->TimerPool : nullptr);
+  entry.Peripherals.reserve(snapshot.Peripherals.size());
+  for (size_t i = 0; i < snapshot.Peripherals.size(); ++i) {
+    bool comparable = previous && i < previous->Peripherals.size();
+    entry.Peripherals.push_back(
+        Store(snapshot.Peripherals[i], comparable ? &previous->Peripherals[i] : nullptr));
+  }
+  Entries_.push_back(std::move(entry));
+
+  NextCheckpoint_ = snapshot.Cycle + IntervalCycles_;
+  Trim();
+}
+
+bool SimCheckpointRing::RewindTo(avr_cycle_count_t cycle) {
+  auto newer = std::upper_bound(Entries_.begin(), Entries_.end(), cycle,
+                                [](avr_cycle_count_t c, const Entry& e) { return c < e.Cycle; });
+  if (newer == Entries_.begin()) {
+    return false;
+  }
+  while (Entries_.end() != newer) {
+    Drop(std::prev(Entries_.end()));
+  }
+
+  const Entry& entry = Entries_.back();
+  SimBoardState::Snapshot snapshot;
+  snapshot.Avr = entry.Avr;
+  snapshot.Cycle = entry.Cycle;
+  snapshot.Core = Load(entry.Core);
+  snapshot.TimerPool = Load(entry.TimerPool);
+  snapshot.Peripherals.reserve(entry.Peripherals.size());
+  for (const auto& blob : entry.Peripherals) {
+    snapshot.Peripherals.push_back(Load(blob));
+  }
+  Board_.Restore(snapshot);
+  NextCheckpoint_ = entry.Cycle + IntervalCycles_;
+
+  avr_t* avr = Board_.Avr();
+  int state = avr->state;
+  while (avr->cycle < cycle && state != cpu_Done && state != cpu_Crashed) {
+    state = avr_run(avr);
+    Poll();
+  }
+  return true;
+}
+
+SimCheckpointRing::Stats SimCheckpointRing::GetStats() const {
+  Stats stats;
+  stats.Checkpoints = Entries_.size();
+  stats.StoredBytes = StoredBytes_;
+  stats.LogicalBytes = LogicalBytes_;
+  if (!Entries_.empty()) {
+    stats.OldestCycle = Entries_.front().Cycle;
+    stats.NewestCycle = Entries_.back().Cycle;
+  }
+  return stats;
+}
+
+SimCheckpointRing::PagedBlob SimCheckpointRing::Store(const std::vector<uint8_t>& blob,
+                                                      const PagedBlob* previous) {
+  PagedBlob paged;
+  paged.Size = blob.size();
+  paged.Pages.reserve((blob.size() + Config_.PageSize - 1) / Config_.PageSize);
+  for (size_t offset = 0; offset < blob.size(); offset += Config_.PageSize) {
+    size_t size = std::min(Config_.PageSize, blob.size() - offset);
+    size_t index = paged.Pages.size();
+    if (previous && index < previous->Pages.size()) {
+      const Page& old = previous->Pages[index];
+      if (old->size() == size && std::memcmp(old->data(), blob.data() + offset, size) == 0) {
+        paged.Pages.push_back(old);
+        continue;
+      }
+    }
+    paged.Pages.push_back(std::make_shared<const std::vector<uint8_t>>(
+        blob.begin() + offset, blob.begin() + offset + size));
+    StoredBytes_ += size;
+  }
+  LogicalBytes_ += blob.size();
+  return paged;
+}
+
+std::vector<uint8_t> SimCheckpointRing::Load(const PagedBlob& blob) {
+  std::vector<uint8_t> out;
+  out.reserve(blob.Size);
+  for (const auto& page : blob.Pages) {
+    out.insert(out.end(), page->begin(), page->end());
+  }
+  return out;
+}
+
+void SimCheckpointRing::Release(const PagedBlob& blob) {
+  for (const auto& page : blob.Pages) {
+    // Pages still shared with a neighbouring checkpoint stay stored.
+    if (page.use_count() == 1) {
+      StoredBytes_ -= page->size();
+    }
+  }
+  LogicalBytes_ -= blob.Size;
+}
+
+void SimCheckpointRing::Drop(std::deque<Entry>::iterator entry) {
+  Release(entry->Core);
+  Release(entry->TimerPool);
+  for (const auto& blob : entry->Peripherals) {
+    Release(blob);
+  }
+  Entries_.erase(entry);
+}
+
+void SimCheckpointRing::Trim() {
+  // Always keep the newest checkpoint, even when it alone is over budget.
+  while (Entries_.size() > 1 && StoredBytes_ > Config_.MemoryBudget) {
+    Drop(Entries_.begin());
+  }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <simavr-toolbox/sim_board_state.hpp>
+#include <vector>
+
+// Keeps a ring of board checkpoints taken every so many simulated milliseconds so that a running
+// simulation can be wound back. Each checkpoint is cut into fixed-size pages and only the pages
+// that differ from the previous checkpoint are stored; the rest are shared. When the stored pages
+// go over the memory budget the oldest checkpoints are dropped.
+//
+// The run loop calls Poll() between avr_run() calls, so checkpoints always sit on an instruction
+// boundary. RewindTo() puts back the newest checkpoint at or before the requested cycle and runs
+// forward from there, which lands on the same state only if the firmware's inputs are replayed
+// the same way: anything fed in from outside the board since then has to be fed in again.
+class SimCheckpointRing {
+ public:
+  struct Config {
+    std::chrono::milliseconds Interval{100};
+    size_t MemoryBudget{64 << 20};
+    // At least 1; 0 is taken as 1.
+    size_t PageSize{256};
+  };
+
+  struct Stats {
+    size_t Checkpoints{0};
+    size_t StoredBytes{0};
+    // Bytes the checkpoints would take without page sharing.
+    size_t LogicalBytes{0};
+    avr_cycle_count_t OldestCycle{0};
+    avr_cycle_count_t NewestCycle{0};
+  };
+
+  SimCheckpointRing(SimBoardState& board, const Config& config);
+  explicit SimCheckpointRing(SimBoardState& board) : SimCheckpointRing(board, Config{}) {}
+
+  // Take a checkpoint if one is due.
+  void Poll() {
+    if (Board_.Avr()->cycle >= NextCheckpoint_) {
+      Checkpoint();
+    }
+  }
+  void Checkpoint();
+
+  // Restore the newest checkpoint at or before `cycle` and run forward to it. Checkpoints after
+  // the restored one are dropped; Poll() takes them again as the simulation moves on. Returns false
+  // when the ring holds nothing that old, leaving the board alone.
+  bool RewindTo(avr_cycle_count_t cycle);
+
+  Stats GetStats() const;
+
+ private:
+  using Page = std::shared_ptr<const std::vector<uint8_t>>;
+
+  // One blob of a SimBoardState::Snapshot, cut into pages.
+  struct PagedBlob {
+    size_t Size{0};
+    std::vector<Page> Pages;
+  };
+
+  struct Entry {
+    const avr_t* Avr;
+    avr_cycle_count_t Cycle;
+    PagedBlob Core;
+    PagedBlob TimerPool;
+    std::vector<PagedBlob> Peripherals;
+  };
+
+  PagedBlob Store(const std::vector<uint8_t>& blob, const PagedBlob* previous);
+  static std::vector<uint8_t> Load(const PagedBlob& blob);
+  void Release(const PagedBlob& blob);
+  void Drop(std::deque<Entry>::iterator entry);
+  void Trim();
+
+  SimBoardState& Board_;
+  Config Config_;
+  avr_cycle_count_t IntervalCycles_;
+  avr_cycle_count_t NextCheckpoint_{0};
+  std::deque<Entry> Entries_;
+  size_t StoredBytes_{0};
+  size_t LogicalBytes_{0};
+};
@@ -0,0 +1,42 @@
+#include "sim_firmware.hpp"
+
+#include <simavr/sim_elf.h>
+#include <simavr/sim_gdb.h>
+
+#include <cstring>
+
+#include "sim_base.hpp"
+
+avr_t* LoadAvrFirmware(std::string_view filename, bool gdb) {
+  avr_t* avr = nullptr;
+
+  elf_firmware_t f;
+  memset(&f, 0, sizeof(f));
+
+  if (elf_read_firmware(filename.data(), &f) != 0) {
+    sim_log(nullptr, SimLogLevel::Error, "Cannot read firmware '%.*s'\n", (int)filename.size(),
+            filename.data());
+    return nullptr;
+  }
+
+  avr = avr_make_mcu_by_name(f.mmcu);
+
+  if (!avr) {
+    sim_log(nullptr, SimLogLevel::Error, "AVR '%s' not known\n", f.mmcu);
+    return nullptr;
+  }
+
+  sim_debug_log(avr, "f=%d mmcu=%s\n", (int)f.frequency, f.mmcu);
+
+  avr_init(avr);
+
+  avr_load_firmware(avr, &f);
+
+  if (gdb) {
+    avr->gdb_port = 1234;
+    avr->state = cpu_Stopped;
+    avr_gdb_init(avr);
+  }
+
+  return avr;
+}
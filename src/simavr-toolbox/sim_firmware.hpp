@@ -0,0 +1,10 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <string_view>
+
+// Load an ELF firmware image into a freshly created AVR of the type recorded in the image. Returns
+// null, after logging why, if the image cannot be read or the MCU is unknown. When `gdb` is set the
+// core is left stopped, waiting for a debugger on port 1234.
+avr_t* LoadAvrFirmware(std::string_view filename, bool gdb);
@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <cstdint>
-#include <string>
 #include <vector>
 
 namespace Font {
@@ -17,6 +16,22 @@ inline constexpr uint8_t u8(auto x) {
   return static_cast<uint8_t>(x);
 }
 
+// The font transposed into columns once, so glyphs can be blitted a column word at a time.
+static const auto kFontColumns = [] {
+  std::array<std::array<uint8_t, 5>, 96> columns{};
+  for (unsigned glyph = 0; glyph < columns.size(); ++glyph) {
+    const unsigned char* rows = &Font::font.Bitmap[glyph * Font::font.Height];
+    for (unsigned row = 0; row < Font::font.Height; ++row) {
+      for (unsigned col = 0; col < columns[glyph].size(); ++col) {
+        if (rows[row] & (1 << (7 - col))) {
+          columns[glyph][col] |= 1 << row;
+        }
+      }
+    }
+  }
+  return columns;
+}();
+
 // constexpr std::string us_command(uint8_t group, uint8_t cmd) {
 //   return std::format("\x1F\x28{:X}{:X}", group, cmd);
 // }
@@ -27,8 +42,9 @@ inline constexpr uint8_t u8(auto x) {
 // }
 
 SimGu7000::SimGu7000() {
-  std::vector<uint8_t> v;
-  Stream s(v);
+  // Enough for a full screen bit image, so display traffic does not allocate.
+  command_arguments_.reserve(9 + DISPLAY_WIDTH * (DISPLAY_HEIGHT / 8));
+  Stream s(command_arguments_);
   ProcessInitializeDisplay(s);
 }
 
@@ -44,13 +60,17 @@ void SimGu7000::ProcessCommand(uint8_t byte) {
   }
 
   if (state_ == State::GettingCommand) {
-    command_buffer_.push_back(byte);
-
-    auto command_it = CommandTable.find(command_buffer_);
+    CommandNode_ = CommandTrie_.Next(CommandNode_, byte);
+    if (CommandNode_ == 0) {
+      // Not the start of any known command, drop it.
+      ResetCommandState();
+      return;
+    }
 
-    if (command_it != CommandTable.end()) {
-      CurrentCommand_ = &command_it->second;
-      if (command_it->second.FixedArgumentBytes == 0) {
+    auto command = CommandTrie_.Nodes[CommandNode_].Command;
+    if (command != CommandTrie::kNoCommand) {
+      CurrentCommand_ = &CommandTable[command];
+      if (CurrentCommand_->Arguments.FixedBytes == 0) {
         ExecuteCurrentCommandAndReset();
       } else {
         state_ = State::GettingCommandArguments;
@@ -58,14 +78,10 @@ void SimGu7000::ProcessCommand(uint8_t byte) {
     }
   } else if (state_ == State::GettingCommandArguments) {
     command_arguments_.push_back(byte);
-    if (command_arguments_.size() == CurrentCommand_->FixedArgumentBytes) {
-      if (CurrentCommand_->SizeGetFn) {
-        CurrentCommandVariableBytes_ = (this->*CurrentCommand_->SizeGetFn)();
-        if (CurrentCommandVariableBytes_ > 0) {
-          state_ = State::GettingVariableArgs;
-        } else {
-          ExecuteCurrentCommandAndReset();
-        }
+    if (command_arguments_.size() == CurrentCommand_->Arguments.FixedBytes) {
+      CurrentCommandVariableBytes_ = GetVariableArgumentBytes();
+      if (CurrentCommandVariableBytes_ > 0) {
+        state_ = State::GettingVariableArgs;
       } else {
         ExecuteCurrentCommandAndReset();
       }
@@ -73,244 +89,257 @@ void SimGu7000::ProcessCommand(uint8_t byte) {
   } else if (state_ == State::GettingVariableArgs) {
     command_arguments_.push_back(byte);
     if (command_arguments_.size() ==
-        (CurrentCommand_->FixedArgumentBytes + CurrentCommandVariableBytes_)) {
+        (CurrentCommand_->Arguments.FixedBytes + CurrentCommandVariableBytes_)) {
       ExecuteCurrentCommandAndReset();
     }
   }
 }
 
-SimGu7000::CommandMap SimGu7000::CommandTable = {
+// Where one sequence is a prefix of another (CompositionMode and the window commands) the shorter
+// one is matched first and the longer is unreachable.
+constexpr SimGu7000::CommandItem SimGu7000::CommandTable[] = {
     // Single byte commands
     // ------------------------------------------------------- //
-    {"\x08",
-     {
-         .Name = "Backspace",
-         .Execute = &SimGu7000::ProcessBackspace,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x09",
-     {
-         .Name = "HorizontalTab",
-         .Execute = &SimGu7000::ProcessHorizontalTab,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x0A",
-     {
-         .Name = "LineFeed",
-         .Execute = &SimGu7000::ProcessLineFeed,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x0B",
-     {
-         .Name = "HomePosition",
-         .Execute = &SimGu7000::ProcessHomePosition,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x0C",
-     {
-         .Name = "DisplayClear",
-         .Execute = &SimGu7000::ProcessDisplayClearCommand,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x0D",
-     {
-         .Name = "CarriageReturn",
-         .Execute = &SimGu7000::ProcessCarriageReturn,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
+    {
+        .Sequence = "\x08",
+        .Name = "Backspace",
+        .Execute = &SimGu7000::ProcessBackspace,
+    },
+    {
+        .Sequence = "\x09",
+        .Name = "HorizontalTab",
+        .Execute = &SimGu7000::ProcessHorizontalTab,
+    },
+    {
+        .Sequence = "\x0A",
+        .Name = "LineFeed",
+        .Execute = &SimGu7000::ProcessLineFeed,
+    },
+    {
+        .Sequence = "\x0B",
+        .Name = "HomePosition",
+        .Execute = &SimGu7000::ProcessHomePosition,
+    },
+    {
+        .Sequence = "\x0C",
+        .Name = "DisplayClear",
+        .Execute = &SimGu7000::ProcessDisplayClearCommand,
+    },
+    {
+        .Sequence = "\x0D",
+        .Name = "CarriageReturn",
+        .Execute = &SimGu7000::ProcessCarriageReturn,
+    },
     // ESC commands (\x1B prefix)
     // ------------------------------------------------------- //
-    {"\x1B\x40",
-     {
-         .Name = "InitializeDisplay",
-         .Execute = &SimGu7000::ProcessInitializeDisplay,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1B\x25",
-     {
-         .Name = "SpecifyDownloadRegister",
-         .Execute = &SimGu7000::ProcessSpecifyDownloadRegister,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1B\x26",
-     {
-         .Name = "DownloadCharacter",
-         .Execute = &SimGu7000::ProcessDownloadCharacter,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1B\x3F",
-     {
-         .Name = "DeleteDownloadedCharacter",
-         .Execute = &SimGu7000::ProcessDeleteDownloadedCharacter,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1B\x52",
-     {
-         .Name = "InternationalFontSet",
-         .Execute = &SimGu7000::ProcessInternationalFontSet,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1B\x74",
-     {
-         .Name = "CharacterCodeType",
-         .Execute = &SimGu7000::ProcessCharacterCodeType,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
+    {
+        .Sequence = "\x1B\x40",
+        .Name = "InitializeDisplay",
+        .Execute = &SimGu7000::ProcessInitializeDisplay,
+    },
+    {
+        .Sequence = "\x1B\x25",
+        .Name = "SpecifyDownloadRegister",
+        .Execute = &SimGu7000::ProcessSpecifyDownloadRegister,
+    },
+    {
+        .Sequence = "\x1B\x26",
+        .Name = "DownloadCharacter",
+        .Execute = &SimGu7000::ProcessDownloadCharacter,
+    },
+    {
+        .Sequence = "\x1B\x3F",
+        .Name = "DeleteDownloadedCharacter",
+        .Execute = &SimGu7000::ProcessDeleteDownloadedCharacter,
+    },
+    {
+        .Sequence = "\x1B\x52",
+        .Name = "InternationalFontSet",
+        .Execute = &SimGu7000::ProcessInternationalFontSet,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1B\x74",
+        .Name = "CharacterCodeType",
+        .Execute = &SimGu7000::ProcessCharacterCodeType,
+        .Arguments = {.FixedBytes = 1},
+    },
     // US commands (\x1F\x28 prefix)
     // ------------------------------------------------------- //
-    {"\x1F\x28\x01",
-     {
-         .Name = "OverwriteMode",
-         .Execute = &SimGu7000::ProcessOverwriteMode,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x02",
-     {
-         .Name = "VerticalScrollMode",
-         .Execute = &SimGu7000::ProcessVerticalScrollMode,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x28\x64\x30",
-     {
-         .Name = "PrintAtPosition",
-         .Execute = &SimGu7000::ProcessCharacterDisplayAtPosition,
-         .SizeGetFn = &SimGu7000::ProcessCharacterDisplayAtPositionSize,
-         .FixedArgumentBytes = 6,
-     }},
-    {"\x1F\x28\x03",
-     {
-         .Name = "HorizontalScrollMode",
-         .Execute = &SimGu7000::ProcessHorizontalScrollMode,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x24",
-     {
-         .Name = "CursorSet",
-         .Execute = &SimGu7000::ProcessCursorSet,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 4,
-     }},
-    {"\x1F\x28\x58",
-     {
-         .Name = "BrightnessControl",
-         .Execute = &SimGu7000::ProcessBrightnessControl,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x72",
-     {
-         .Name = "ReverseDisplay",
-         .Execute = &SimGu7000::ProcessReverseDisplay,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x73",
-     {
-         .Name = "HorizontalScrollSpeed",
-         .Execute = &SimGu7000::ProcessHorizontalScrollSpeed,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x77",
-     {
-         .Name = "CompositionMode",
-         .Execute = &SimGu7000::ProcessCompositionMode,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
+    {
+        .Sequence = "\x1F\x28\x01",
+        .Name = "OverwriteMode",
+        .Execute = &SimGu7000::ProcessOverwriteMode,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x02",
+        .Name = "VerticalScrollMode",
+        .Execute = &SimGu7000::ProcessVerticalScrollMode,
+    },
+    {
+        .Sequence = "\x1F\x28\x64\x30",
+        .Name = "PrintAtPosition",
+        .Execute = &SimGu7000::ProcessCharacterDisplayAtPosition,
+        .Arguments = {.FixedBytes = 6, .LengthOffset = 5},
+    },
+    {
+        .Sequence = "\x1F\x28\x03",
+        .Name = "HorizontalScrollMode",
+        .Execute = &SimGu7000::ProcessHorizontalScrollMode,
+    },
+    {
+        .Sequence = "\x1F\x24",
+        .Name = "CursorSet",
+        .Execute = &SimGu7000::ProcessCursorSet,
+        .Arguments = {.FixedBytes = 4},
+    },
+    {
+        .Sequence = "\x1F\x28\x58",
+        .Name = "BrightnessControl",
+        .Execute = &SimGu7000::ProcessBrightnessControl,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x72",
+        .Name = "ReverseDisplay",
+        .Execute = &SimGu7000::ProcessReverseDisplay,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x73",
+        .Name = "HorizontalScrollSpeed",
+        .Execute = &SimGu7000::ProcessHorizontalScrollSpeed,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x77",
+        .Name = "CompositionMode",
+        .Execute = &SimGu7000::ProcessCompositionMode,
+        .Arguments = {.FixedBytes = 1},
+    },
     // US Extended commands (\x1F\x28 prefix with sub-commands)
     // ------------------------------------------------------- //
-    {"\x1F\x28\x61\x01",
-     {
-         .Name = "Wait",
-         .Execute = &SimGu7000::ProcessWait,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x28\x61\x10",
-     {
-         .Name = "ScrollDisplayAction",
-         .Execute = &SimGu7000::ProcessScrollDisplayAction,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x28\x61\x11",
-     {
-         .Name = "DisplayBlink",
-         .Execute = &SimGu7000::ProcessDisplayBlink,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x28\x61\x40",
-     {
-         .Name = "ScreenSaver",
-         .Execute = &SimGu7000::ProcessScreenSaver,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x64\x21",
-     {
-         .Name = "RealTimeBitImageDisplay",
-         .Execute = &SimGu7000::ProcessRealTimeBitImageDisplayXy,
-         .SizeGetFn = &SimGu7000::ProcessRealTimeBitImageDisplaySize,
-         .FixedArgumentBytes = 9,
-     }},
-    {"\x1F\x28\x67\x03",
-     {
-         .Name = "CharacterFontWidthAndSpace",
-         .Execute = &SimGu7000::ProcessCharacterFontWidthAndSpace,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x67\x40",
-     {
-         .Name = "FontMagnificationSet",
-         .Execute = &SimGu7000::ProcessFontMagnificationSet,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 2,
-     }},
-    {"\x1F\x28\x77\x01",
-     {
-         .Name = "CurrentWindowSelect",
-         .Execute = &SimGu7000::ProcessCurrentWindowSelect,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
-    {"\x1F\x28\x77\x02",
-     {
-         .Name = "UserWindowDefinitionCancel",
-         .Execute = &SimGu7000::ProcessUserWindowDefinitionCancel,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 0,
-     }},
-    {"\x1F\x28\x77\x10",
-     {
-         .Name = "WriteScreenModeSelect",
-         .Execute = &SimGu7000::ProcessWriteScreenModeSelect,
-         .SizeGetFn = nullptr,
-         .FixedArgumentBytes = 1,
-     }},
+    {
+        .Sequence = "\x1F\x28\x61\x01",
+        .Name = "Wait",
+        .Execute = &SimGu7000::ProcessWait,
+    },
+    {
+        .Sequence = "\x1F\x28\x61\x10",
+        .Name = "ScrollDisplayAction",
+        .Execute = &SimGu7000::ProcessScrollDisplayAction,
+    },
+    {
+        .Sequence = "\x1F\x28\x61\x11",
+        .Name = "DisplayBlink",
+        .Execute = &SimGu7000::ProcessDisplayBlink,
+    },
+    {
+        .Sequence = "\x1F\x28\x61\x40",
+        .Name = "ScreenSaver",
+        .Execute = &SimGu7000::ProcessScreenSaver,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x64\x21",
+        .Name = "RealTimeBitImageDisplay",
+        .Execute = &SimGu7000::ProcessRealTimeBitImageDisplayXy,
+        .Arguments = {.FixedBytes = 9, .LengthOffset = 4, .LengthBytes = 2, .RowsOffset = 6},
+    },
+    {
+        .Sequence = "\x1F\x28\x67\x03",
+        .Name = "CharacterFontWidthAndSpace",
+        .Execute = &SimGu7000::ProcessCharacterFontWidthAndSpace,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x67\x40",
+        .Name = "FontMagnificationSet",
+        .Execute = &SimGu7000::ProcessFontMagnificationSet,
+        .Arguments = {.FixedBytes = 2},
+    },
+    {
+        .Sequence = "\x1F\x28\x77\x01",
+        .Name = "CurrentWindowSelect",
+        .Execute = &SimGu7000::ProcessCurrentWindowSelect,
+        .Arguments = {.FixedBytes = 1},
+    },
+    {
+        .Sequence = "\x1F\x28\x77\x02",
+        .Name = "UserWindowDefinitionCancel",
+        .Execute = &SimGu7000::ProcessUserWindowDefinitionCancel,
+    },
+    {
+        .Sequence = "\x1F\x28\x77\x10",
+        .Name = "WriteScreenModeSelect",
+        .Execute = &SimGu7000::ProcessWriteScreenModeSelect,
+        .Arguments = {.FixedBytes = 1},
+    },
 };
 
-const SimGu7000::DisplayMemory& SimGu7000::GetDisplayMemory() const {
+constexpr SimGu7000::CommandTrie SimGu7000::BuildCommandTrie(
+    std::span<const CommandItem> commands) {
+  // Insert every sequence into a dense child table first, then pack the children of each node
+  // into a contiguous run of edges.
+  struct DenseNode {
+    int8_t Command{CommandTrie::kNoCommand};
+    std::array<uint8_t, 256> Children{};
+  };
+  std::array<DenseNode, CommandTrie::kMaxNodes> dense{};
+  uint8_t node_count = 1;
+
+  for (size_t i = 0; i < commands.size(); ++i) {
+    uint8_t node = 0;
+    for (char c : commands[i].Sequence) {
+      if (dense[node].Command != CommandTrie::kNoCommand) {
+        break;
+      }
+      auto& child = dense[node].Children[static_cast<uint8_t>(c)];
+      if (child == 0) {
+        child = node_count++;
+      }
+      node = child;
+    }
+    if (dense[node].Command == CommandTrie::kNoCommand) {
+      dense[node].Command = static_cast<int8_t>(i);
+    }
+  }
+
+  CommandTrie trie;
+  uint8_t edge_count = 0;
+  for (uint8_t node = 0; node < node_count; ++node) {
+    trie.Nodes[node].Command = dense[node].Command;
+    trie.Nodes[node].FirstEdge = edge_count;
+    if (dense[node].Command != CommandTrie::kNoCommand) {
+      continue;
+    }
+    for (unsigned byte = 0; byte < 256; ++byte) {
+      if (dense[node].Children[byte]) {
+        trie.Edges[edge_count++] = {static_cast<uint8_t>(byte), dense[node].Children[byte]};
+      }
+    }
+    trie.Nodes[node].EdgeCount = edge_count - trie.Nodes[node].FirstEdge;
+  }
+  return trie;
+}
+
+constexpr SimGu7000::CommandTrie SimGu7000::CommandTrie_ = BuildCommandTrie(CommandTable);
+
+const SimGu7000::DisplayColumns& SimGu7000::GetDisplayColumns() const {
   return display_memory_;
 }
 
+SimGu7000::DisplayMemory SimGu7000::GetDisplayMemory() const {
+  DisplayMemory unpacked;
+  for (uint16_t x = 0; x < DISPLAY_WIDTH; ++x) {
+    for (uint16_t y = 0; y < DISPLAY_HEIGHT; ++y) {
+      unpacked[x][y] = (display_memory_[x] >> y) & 1;
+    }
+  }
+  return unpacked;
+}
+
 uint8_t SimGu7000::Width() const {
   return DISPLAY_WIDTH;
 }
@@ -320,9 +349,7 @@ uint8_t SimGu7000::Height() const {
 }
 
 void SimGu7000::ClearDisplayMemory() {
-  for (auto& column : display_memory_) {
-    column.fill(false);
-  }
+  display_memory_.fill(0);
 }
 
 void SimGu7000::SetCursor(uint16_t x, uint16_t y) {
@@ -360,12 +387,14 @@ void SimGu7000::DrawCharacterAt(uint16_t x, uint16_t y, uint8_t character) {
 }
 
 // Helper methods
-void SimGu7000::SetPixel(uint16_t x, uint16_t y, bool on) {
+void SimGu7000::BlitColumn(uint16_t x, uint16_t y, uint16_t bits, uint16_t height) {
   if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
     return;
   }
 
-  display_memory_.at(x).at(y) = on;
+  // Replace rows y to y + height with bits, clipped to the bottom of the display.
+  uint32_t mask = ((1u << std::min<uint16_t>(height, DISPLAY_HEIGHT)) - 1) << y;
+  display_memory_[x] = (display_memory_[x] & ~mask) | ((uint32_t{bits} << y) & mask);
 }
 
 bool SimGu7000::GetPixel(uint16_t x, uint16_t y) const {
@@ -373,54 +402,35 @@ bool SimGu7000::GetPixel(uint16_t x, uint16_t y) const {
     return false;
   }
 
-  return display_memory_[x][y];
+  return (display_memory_[x] >> y) & 1;
 }
 
 void SimGu7000::DrawFontCharacter(uint16_t x, uint16_t y, uint8_t character) {
-  auto font_data = GetFontData(character);
-  DrawImage(x, y, font_data, FONT_WIDTH, FONT_HEIGHT);
-}
-
-void SimGu7000::DrawImage(uint16_t x, uint16_t y, const FontCharSpan& image, uint8_t width,
-                          uint8_t height) {
-  if (image.empty()) {
-    return;
-  }
-
-  // Draw each column of the character
-  for (uint8_t row = 0; row < height; ++row) {
-    int row_data = image[row];
-
-    // Draw each pixel in the column with magnification
-    for (uint8_t col = 0; col < width; ++col) {
-      bool pixel_on = (row_data & (1 << (7 - col))) != 0;
-
-      // Apply magnification
-      for (uint8_t mx = 0; mx < font_magnification_x_; ++mx) {
-        for (uint8_t my = 0; my < font_magnification_y_; ++my) {
-          uint16_t pixel_x = x + col * font_magnification_x_ + mx;
-          uint16_t pixel_y = y + row * font_magnification_y_ + my;
-
-          if (pixel_x < DISPLAY_WIDTH && pixel_y < DISPLAY_HEIGHT) {
-            SetPixel(pixel_x, pixel_y, pixel_on);
-          }
-        }
+  const auto& glyph = GetFontData(character);
+  const uint16_t height = FONT_HEIGHT * font_magnification_y_;
+
+  for (uint8_t col = 0; col < FONT_WIDTH; ++col) {
+    // Stretch the column vertically by repeating each row
+    uint16_t bits = 0;
+    for (uint8_t row = 0; row < FONT_HEIGHT; ++row) {
+      if (glyph[col] & (1 << row)) {
+        bits |= ((1 << font_magnification_y_) - 1) << (row * font_magnification_y_);
       }
     }
+
+    // ... and horizontally by repeating the column
+    for (uint8_t mx = 0; mx < font_magnification_x_; ++mx) {
+      BlitColumn(x + col * font_magnification_x_ + mx, y, bits, height);
+    }
   }
 }
 
-SimGu7000::FontCharSpan SimGu7000::GetFontData(uint8_t character) const {
-  auto GetTheData = [](char c) {
-    auto begin = &Font::font.Bitmap[(c - 31) * Font::font.Height];
-    return FontCharSpan(begin, Font::font.Height);
-  };
-
+const SimGu7000::GlyphColumns& SimGu7000::GetFontData(uint8_t character) const {
   if (character < 32 || character > 126) {
-    return GetTheData(' ');  // Return space for invalid characters
+    return kFontColumns[' ' - 31];  // Return space for invalid characters
   }
 
-  return GetTheData(character);
+  return kFontColumns[character - 31];
 }
 
 void SimGu7000::ExecuteCurrentCommandAndReset() {
@@ -429,14 +439,85 @@ void SimGu7000::ExecuteCurrentCommandAndReset() {
   ResetCommandState();
 }
 
+void SimGu7000::SaveState(SimStateWriter& out) const {
+  out.Write(display_memory_);
+  out.Write(cursor_x_);
+  out.Write(cursor_y_);
+  out.Write(initialized_);
+  out.Write(international_font_set_);
+  out.Write(character_code_type_);
+  out.Write(overwrite_mode_);
+  out.Write(scroll_mode_);
+  out.Write(horizontal_scroll_speed_);
+  out.Write(brightness_level_);
+  out.Write(reverse_display_);
+  out.Write(composition_mode_);
+  out.Write(current_window_);
+  out.Write(font_magnification_x_);
+  out.Write(font_magnification_y_);
+
+  out.Write(state_);
+  out.Write(CommandNode_);
+  // The command in progress is stored as its index in CommandTable, -1 for none.
+  out.Write<int16_t>(CurrentCommand_ ? CurrentCommand_ - CommandTable : -1);
+  out.Write(CurrentCommandVariableBytes_);
+  out.WriteVector(command_arguments_);
+}
+
+void SimGu7000::RestoreState(SimStateReader& in) {
+  in.Read(display_memory_);
+  in.Read(cursor_x_);
+  in.Read(cursor_y_);
+  in.Read(initialized_);
+  in.Read(international_font_set_);
+  in.Read(character_code_type_);
+  in.Read(overwrite_mode_);
+  in.Read(scroll_mode_);
+  in.Read(horizontal_scroll_speed_);
+  in.Read(brightness_level_);
+  in.Read(reverse_display_);
+  in.Read(composition_mode_);
+  in.Read(current_window_);
+  in.Read(font_magnification_x_);
+  in.Read(font_magnification_y_);
+
+  in.Read(state_);
+  in.Read(CommandNode_);
+  auto command = in.Read<int16_t>();
+  CurrentCommand_ = command < 0 ? nullptr : &CommandTable[command];
+  in.Read(CurrentCommandVariableBytes_);
+  in.ReadVector(command_arguments_);
+}
+
 void SimGu7000::ResetCommandState() {
-  command_buffer_.clear();
   command_arguments_.clear();
   state_ = State::Idle;
+  CommandNode_ = 0;
   CurrentCommand_ = nullptr;
   CurrentCommandVariableBytes_ = 0;
 }
 
+uint16_t SimGu7000::GetArgument(uint8_t offset, uint8_t bytes) const {
+  uint16_t value = command_arguments_[offset];
+  if (bytes == 2) {
+    value |= command_arguments_[offset + 1] << 8;
+  }
+  return value;
+}
+
+uint16_t SimGu7000::GetVariableArgumentBytes() const {
+  const auto& arguments = CurrentCommand_->Arguments;
+  if (arguments.LengthOffset == ArgumentSchema::kNone) {
+    return 0;
+  }
+
+  uint16_t length = GetArgument(arguments.LengthOffset, arguments.LengthBytes);
+  if (arguments.RowsOffset != ArgumentSchema::kNone) {
+    length *= GetArgument(arguments.RowsOffset, 2) / 8;
+  }
+  return length;
+}
+
 // Command implementations
 void SimGu7000::ProcessCharacterDisplay(uint8_t character) {
   DrawCharacterAtCursor(character);
@@ -453,15 +534,6 @@ void SimGu7000::ProcessCharacterDisplayAtPosition(Stream& params) {
   }
 }
 
-uint16_t SimGu7000::ProcessCharacterDisplayAtPositionSize() const {
-  Stream s(command_arguments_);
-  uint16_t x, y;
-  ExtractXY(s, x, y);
-  uint8_t _ = s.get_uint8();  // Unused "m"
-  uint8_t len = s.get_uint8();
-  return len;
-}
-
 void SimGu7000::ProcessBackspace(Stream&) {
   if (cursor_x_ >= FONT_WIDTH * font_magnification_x_) {
     cursor_x_ -= FONT_WIDTH * font_magnification_x_;
@@ -594,9 +666,7 @@ void SimGu7000::ProcessScreenSaver(Stream& params) {
       ClearDisplayMemory();
       break;
     case 3:  // All dots on
-      for (auto& column : display_memory_) {
-        column.fill(true);
-      }
+      display_memory_.fill(0xFFFF);
       break;
     case 1:  // Power on
     case 4:  // Repeat normal & reverse display
@@ -617,11 +687,19 @@ void SimGu7000::ProcessRealTimeBitImageDisplay(Stream& params, uint8_t x, uint8_
   ExtractXY(params, w, h);
   uint8_t _ = params.get_uint8();  // Discard "g" (always 1)
 
-  for (uint8_t i = 0; i < (h / 8) * w; i++) {
-    uint8_t byte = params.get_uint8();
-    for (uint8_t j = 0; j < h; ++j) {
-      SetPixel(x + i, y + j, byte & (1 << (7 - j)));
+  // Each column is h / 8 bytes, top row in the MSB of the first byte.
+  const uint16_t column_bytes = h / 8;
+  for (uint16_t i = 0; i < w; i++) {
+    uint16_t bits = 0;
+    for (uint16_t j = 0; j < column_bytes; ++j) {
+      uint8_t byte = params.get_uint8();
+      for (uint8_t k = 0; k < 8 && j * 8 + k < DISPLAY_HEIGHT; ++k) {
+        if (byte & (1 << (7 - k))) {
+          bits |= 1 << (j * 8 + k);
+        }
+      }
     }
+    BlitColumn(x + i, y, bits, column_bytes * 8);
   }
 }
 
@@ -668,13 +746,3 @@ void SimGu7000::ExtractXY(Stream& s, uint16_t& x, uint16_t& y) const {
   x = s.get_uint16le();
   y = s.get_uint16le();
 }
-
-uint16_t SimGu7000::ProcessRealTimeBitImageDisplaySize() const {
-  Stream s(command_arguments_);
-
-  uint16_t x, y, w, h;
-  ExtractXY(s, x, y);
-  ExtractXY(s, w, h);
-
-  return (h / 8) * w;
-}
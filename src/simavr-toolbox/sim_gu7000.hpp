@@ -5,9 +5,9 @@
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <simavr-toolbox/sim_state.hpp>
 #include <span>
-#include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 class Stream {
@@ -41,17 +41,24 @@ class SimGu7000 {
   static constexpr uint8_t DISPLAY_WIDTH = 112;
   static constexpr uint8_t DISPLAY_HEIGHT = 16;
 
+  // One word per column, bit y set when the dot in row y is lit.
+  typedef std::array<uint16_t, DISPLAY_WIDTH> DisplayColumns;
   typedef std::array<std::array<bool, DISPLAY_HEIGHT>, DISPLAY_WIDTH> DisplayMemory;
 
   SimGu7000();
   void ProcessCommand(uint8_t command);
   uint8_t Width() const;
   uint8_t Height() const;
-  const DisplayMemory& GetDisplayMemory() const;
+  const DisplayColumns& GetDisplayColumns() const;
+  bool GetPixel(uint16_t x, uint16_t y) const;
+  // Unpacked copy of the display, for consumers that index dots as [x][y].
+  DisplayMemory GetDisplayMemory() const;
 
- private:
-  typedef std::span<const uint8_t, 7> FontCharSpan;
+  // Display contents, settings and any half-received command.
+  void SaveState(SimStateWriter& out) const;
+  void RestoreState(SimStateReader& in);
 
+ private:
   // Font dimensions (5x7)
   static constexpr uint8_t FONT_WIDTH = 5;
   static constexpr uint8_t FONT_HEIGHT = 7;
@@ -61,16 +68,14 @@ class SimGu7000 {
   static constexpr uint8_t CMD_CHARACTER_DISPLAY_START = 0x20;
   static constexpr uint8_t CMD_CHARACTER_DISPLAY_END = 0xFF;
 
-  // Display memory: 112x16 pixels as bool array
-  // Each element represents one pixel
-  DisplayMemory display_memory_;
+  // Display memory: 112x16 pixels packed into column words
+  DisplayColumns display_memory_;
 
   // Cursor position (in pixels)
   uint16_t cursor_x_;
   uint16_t cursor_y_;
 
   // Font and display settings
-  std::vector<uint8_t> commandBytes_;
   bool initialized_;
   uint8_t international_font_set_;
   uint8_t character_code_type_;
@@ -85,7 +90,6 @@ class SimGu7000 {
   uint8_t font_magnification_y_;
 
   // Command state tracking
-  std::string command_buffer_;
   std::vector<uint8_t> command_arguments_;
 
   // Display memory access
@@ -101,12 +105,13 @@ class SimGu7000 {
   void DrawCharacterAtCursor(uint8_t character);
   void DrawCharacterAt(uint16_t x, uint16_t y, uint8_t character);
 
+  // Glyph columns, bit row set when the dot in that row is lit.
+  typedef std::array<uint8_t, FONT_WIDTH> GlyphColumns;
+
   // Helper methods
-  void SetPixel(uint16_t x, uint16_t y, bool on);
-  bool GetPixel(uint16_t x, uint16_t y) const;
+  void BlitColumn(uint16_t x, uint16_t y, uint16_t bits, uint16_t height);
   void DrawFontCharacter(uint16_t x, uint16_t y, uint8_t character);
-  void DrawImage(uint16_t x, uint16_t y, const FontCharSpan& image, uint8_t width, uint8_t height);
-  FontCharSpan GetFontData(uint8_t character) const;
+  const GlyphColumns& GetFontData(uint8_t character) const;
 
   // Command state tracking
 
@@ -118,29 +123,75 @@ class SimGu7000 {
   };
 
   typedef void (SimGu7000::*CommandFunction)(Stream&);
-  typedef uint16_t (SimGu7000::*SizeGetFnFunction)() const;
+
+  // Layout of a command's arguments: a fixed part, optionally followed by a variable part whose
+  // length is the little-endian field at LengthOffset. For bit images that length is in columns
+  // and is multiplied by the number of 8 dot rows in the height field at RowsOffset.
+  struct ArgumentSchema {
+    static constexpr uint8_t kNone = 0xFF;
+
+    uint8_t FixedBytes{0};
+    uint8_t LengthOffset{kNone};
+    uint8_t LengthBytes{1};
+    uint8_t RowsOffset{kNone};
+  };
 
   struct CommandItem {
+    std::string_view Sequence;
     const char* Name;
-    const CommandFunction Execute;
-    const SizeGetFnFunction SizeGetFn;
-    const uint8_t FixedArgumentBytes;
+    CommandFunction Execute;
+    ArgumentSchema Arguments;
+  };
+
+  // Prefix trie over the command sequences, built at compile time. Node 0 is the root and a node
+  // that completes a command has no children, so the shortest matching sequence wins.
+  struct CommandTrie {
+    static constexpr uint8_t kMaxNodes = 64;
+    static constexpr int8_t kNoCommand = -1;
+
+    struct Node {
+      int8_t Command{kNoCommand};
+      uint8_t FirstEdge{0};
+      uint8_t EdgeCount{0};
+    };
+
+    struct Edge {
+      uint8_t Byte{0};
+      uint8_t Child{0};
+    };
+
+    // Returns the child of node reached by byte, or 0 if there is none.
+    constexpr uint8_t Next(uint8_t node, uint8_t byte) const {
+      const auto& n = Nodes[node];
+      for (uint8_t i = n.FirstEdge; i < n.FirstEdge + n.EdgeCount; ++i) {
+        if (Edges[i].Byte == byte) {
+          return Edges[i].Child;
+        }
+      }
+      return 0;
+    }
+
+    std::array<Node, kMaxNodes> Nodes{};
+    std::array<Edge, kMaxNodes> Edges{};
   };
 
-  typedef std::unordered_map<std::string, CommandItem> CommandMap;
+  static constexpr CommandTrie BuildCommandTrie(std::span<const CommandItem> commands);
 
   State state_{State::Idle};
-  static CommandMap CommandTable;
-  CommandItem* CurrentCommand_{nullptr};
+  static const CommandItem CommandTable[];
+  static const CommandTrie CommandTrie_;
+  uint8_t CommandNode_{0};
+  const CommandItem* CurrentCommand_{nullptr};
   uint16_t CurrentCommandVariableBytes_{0};
 
+  uint16_t GetArgument(uint8_t offset, uint8_t bytes) const;
+  uint16_t GetVariableArgumentBytes() const;
   void ExecuteCurrentCommandAndReset();
   void ResetCommandState();
 
   // Command implementations
   void ProcessCharacterDisplay(uint8_t character);
   void ProcessCharacterDisplayAtPosition(Stream& params);
-  uint16_t ProcessCharacterDisplayAtPositionSize() const;
   void ProcessBackspace(Stream& params);
   void ProcessHorizontalTab(Stream& params);
   void ProcessLineFeed(Stream& params);
@@ -165,7 +216,6 @@ class SimGu7000 {
   void ProcessScreenSaver(Stream& params);
   void ProcessRealTimeBitImageDisplayXy(Stream& params);
   void ProcessRealTimeBitImageDisplay(Stream& params, uint8_t x, uint8_t y);
-  uint16_t ProcessRealTimeBitImageDisplaySize() const;
   void ProcessCharacterFontWidthAndSpace(Stream& params);
   void ProcessFontMagnificationSet(Stream& params);
   void ProcessCurrentWindowSelect(Stream& params);
@@ -1,25 +1,79 @@
 #include "sim_gu7000_i2c.hpp"
 
-SimGu7000I2C::SimGu7000I2C(avr_t* avr) : SimAvrI2CSmarterComponent(avr, 0x50) {}
+SimGu7000I2C::SimGu7000I2C(avr_t* avr, uint8_t i2cAddress)
+    : SimAvrI2CTransactionComponent(avr, i2cAddress),
+      display_publisher_(avr, [this] { display_snapshot_.Publish(screen_.GetDisplayColumns()); }),
+      ticks_(SimTickService::Get(avr)) {
+  display_publisher_.Flush();
+}
+
+SimGu7000I2C::~SimGu7000I2C() {
+  ticks_->Unsubscribe(SimTickService::kMillisecond, this);
+}
+
+const SimGu7000::DisplayColumns& SimGu7000I2C::GetDisplayColumns() const {
+  return screen_.GetDisplayColumns();
+}
 
-const SimGu7000::DisplayMemory& SimGu7000I2C::GetDisplayMemory() const {
+SimGu7000::DisplayMemory SimGu7000I2C::GetDisplayMemory() const {
   return screen_.GetDisplayMemory();
 }
 
-void SimGu7000I2C::OnMillisecondPassed() {
+SimSnapshot<SimGu7000::DisplayColumns>& SimGu7000I2C::GetDisplaySnapshot() {
+  return display_snapshot_;
+}
+
+void SimGu7000I2C::SaveState(SimStateWriter& out) const {
+  SimAvrI2CTransactionComponent::SaveState(out);
+  screen_.SaveState(out);
+  out.Write(last_command_debounce_ms_);
+  out.Write(screen_dirty_);
+}
+
+void SimGu7000I2C::RestoreState(SimStateReader& in) {
+  SimAvrI2CTransactionComponent::RestoreState(in);
+  screen_.RestoreState(in);
+  in.Read(last_command_debounce_ms_);
+  in.Read(screen_dirty_);
+  UpdateTickSubscription();
+  display_publisher_.Flush();
+}
+
+uint64_t SimGu7000I2C::GetDebounceMs() const {
+  return last_command_debounce_ms_;
+}
+
+bool SimGu7000I2C::OnMillisecondPassed(void* param, avr_cycle_count_t when) {
+  auto that = static_cast<SimGu7000I2C*>(param);
+  if (!that->screen_dirty_) {
+    return false;
+  }
+  that->last_command_debounce_ms_ += 1;
+  return true;
+}
+
+void SimGu7000I2C::UpdateTickSubscription() {
+  // Only a dirty screen has a debounce to count.
   if (screen_dirty_) {
-    last_command_debounce_ms_ += 1;
+    ticks_->Subscribe(SimTickService::kMillisecond, OnMillisecondPassed, this);
+  } else {
+    ticks_->Unsubscribe(SimTickService::kMillisecond, this);
   }
 }
 
 void SimGu7000I2C::CleanScreen() {
   screen_dirty_ = false;
+  UpdateTickSubscription();
 }
 
-void SimGu7000I2C::OnDataReceived(const std::vector<uint8_t>& data) {
+void SimGu7000I2C::OnWrite(std::span<const uint8_t> data) {
   last_command_debounce_ms_ = 0;
-  screen_dirty_ = true;
+  if (!screen_dirty_) {
+    screen_dirty_ = true;
+    UpdateTickSubscription();
+  }
   for (auto byte : data) {
     screen_.ProcessCommand(byte);
   }
+  display_publisher_.MarkDirty();
 }
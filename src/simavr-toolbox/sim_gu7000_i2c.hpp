@@ -1,21 +1,41 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <span>
 
 #include "sim_gu7000.hpp"
-#include "sim_i2c_smarter_base.hpp"
+#include "sim_i2c_transaction_base.hpp"
+#include "sim_snapshot.hpp"
+#include "sim_tick_service.hpp"
 
-class SimGu7000I2C : public SimAvrI2CSmarterComponent {
+class SimGu7000I2C : public SimAvrI2CTransactionComponent {
  public:
-  SimGu7000I2C(avr_t* avr);
-  const SimGu7000::DisplayMemory& GetDisplayMemory() const;
-  void OnMillisecondPassed();
+  static constexpr uint8_t kDefaultAddress = 0x50;
+
+  explicit SimGu7000I2C(avr_t* avr, uint8_t i2cAddress = kDefaultAddress);
+  ~SimGu7000I2C();
+  const SimGu7000::DisplayColumns& GetDisplayColumns() const;
+  SimGu7000::DisplayMemory GetDisplayMemory() const;
+  // Display contents for the UI thread, published at most once per frame.
+  SimSnapshot<SimGu7000::DisplayColumns>& GetDisplaySnapshot();
+  // Milliseconds of simulated time since the last command, counted while the screen is dirty.
+  uint64_t GetDebounceMs() const;
+  // Simulation thread only; post it from the UI.
   void CleanScreen();
 
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
+
  private:
-  void OnDataReceived(const std::vector<uint8_t>& data) override;
+  void OnWrite(std::span<const uint8_t> data) override;
+  static bool OnMillisecondPassed(void* param, avr_cycle_count_t when);
+  void UpdateTickSubscription();
 
   SimGu7000 screen_;
   uint64_t last_command_debounce_ms_{0};
   bool screen_dirty_{false};
+  SimSnapshot<SimGu7000::DisplayColumns> display_snapshot_;
+  SimSnapshotPublisher display_publisher_;
+  std::shared_ptr<SimTickService> ticks_;
 };
@@ -6,13 +6,15 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <simavr-toolbox/sim_i2c_bus.hpp>
+#include <simavr-toolbox/sim_state.hpp>
 
-using I2cMessageCallback = std::function<void(uint32_t)>;
 using IrqCallback = std::function<avr_cycle_count_t(avr_cycle_count_t when)>;
 
-class SimAvrI2CComponent {
+class SimAvrI2CComponent : public SimStateful, private SimI2CBus::Device {
  public:
-  using I2cAddressMatcher = std::function<bool(avr_twi_msg_t*)>;
+  using I2cAddressMatcher = SimI2CBus::AddressMatcher;
 
   SimAvrI2CComponent(avr_t* avr, uint8_t i2cAddressRightShifted);
   SimAvrI2CComponent(avr_t* avr, uint8_t i2cAddressRightShifted,
@@ -20,6 +22,16 @@ class SimAvrI2CComponent {
   ~SimAvrI2CComponent();
   virtual void HandleI2CMessage(const avr_twi_msg_t& msg) = 0;
   virtual void ResetStateMachine();
+  // False when the bus refused the address because another device has it; the component then
+  // hears nothing.
+  bool IsAttached() const;
+  // Number of TWI bus messages routed to this component.
+  uint64_t GetCallbackCount() const;
+
+  // Whether a transaction with this device is in progress. Subclasses extend these with their own
+  // state, calling the base class first.
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
 
  protected:
   avr_t* Avr_{nullptr};
@@ -29,14 +41,11 @@ class SimAvrI2CComponent {
   static bool MatchesI2cAddress(const avr_twi_msg_t& message, uint8_t i2cAddress);
 
  private:
-  avr_twi_msg_t Parseavr_twi_msg_t(uint32_t value);
-  void HandleAnyI2cMessage(uint32_t value);
+  void OnI2cBusMessage(const avr_twi_msg_t& msg) override;
+  void OnI2cBusDeselected() override;
 
-  enum MyIrqType { Input = 0, Output, Count };
-  static const char* irq_names[MyIrqType::Count];
-  avr_irq_t* MyIrqs_{nullptr};
-  avr_irq_t* MyOutputIrq_{nullptr};
+  std::shared_ptr<SimI2CBus> Bus_;
   uint8_t I2cAddress_{0};
-  I2cAddressMatcher AddressMatcher_;
-  I2cMessageCallback i2c_message_callback_;
+  bool Attached_{false};
+  uint64_t CallbackCount_{0};
 };
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "sim_i2c_bus.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <simavr-toolbox/sim_avr_registry.hpp>
+#include <simavr-toolbox/sim_base.hpp>
+
+static avr_twi_msg_t ParseTwiMsg(uint32_t value) {
+  avr_twi_msg_irq_t v;
+  v.u.v = value;
+  return v.u.twi;
+}
+
+static void FromAvrCb(struct avr_irq_t* irq, uint32_t value, void* param) {
+  auto that = (SimI2CBus*)param;
+  that->HandleMessageFromAvr(ParseTwiMsg(value));
+}
+
+static void ToAvrCb(struct avr_irq_t* irq, uint32_t value, void* param) {
+  auto observers = (std::vector<SimI2CBus::Observer*>*)param;
+  auto msg = ParseTwiMsg(value);
+  for (auto observer : *observers) {
+    observer->OnMessageToAvr(msg);
+  }
+}
+
+const char* SimI2CBus::irq_names[MyIrqType::Count] = {
+    [MyIrqType::Input] = "I2CBusIn",
+    [MyIrqType::Output] = "I2CBusOut",
+};
+
+std::shared_ptr<SimI2CBus> SimI2CBus::Get(avr_t* avr) {
+  return GetPerAvrInstance<SimI2CBus>(avr);
+}
+
+SimI2CBus::SimI2CBus(avr_t* avr) : Avr_(avr) {
+  MyIrqs_ = avr_alloc_irq(&avr->irq_pool, 0, MyIrqType::Count, irq_names);
+
+  avr_connect_irq(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                  &MyIrqs_[MyIrqType::Input]);
+
+  avr_connect_irq(&MyIrqs_[MyIrqType::Output],
+                  avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+
+  avr_irq_register_notify(&MyIrqs_[MyIrqType::Input], FromAvrCb, this);
+}
+
+SimI2CBus::~SimI2CBus() {
+  if (!Observers_.empty()) {
+    avr_irq_unregister_notify(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT), ToAvrCb,
+                              &Observers_);
+  }
+  avr_unconnect_irq(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                    &MyIrqs_[MyIrqType::Input]);
+  avr_unconnect_irq(&MyIrqs_[MyIrqType::Output],
+                    avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+  avr_free_irq(MyIrqs_, MyIrqType::Count);
+}
+
+bool SimI2CBus::AttachDevice(uint8_t i2cAddressRightShifted, Device* device) {
+  if (i2cAddressRightShifted >= Devices_.size()) {
+    sim_log(Avr_, SimLogLevel::Error, "I2C address 0x%02x is out of range\n",
+            (int)i2cAddressRightShifted);
+    return false;
+  }
+  if (Devices_[i2cAddressRightShifted]) {
+    sim_log(Avr_, SimLogLevel::Error, "I2C address 0x%02x is already in use\n",
+            (int)i2cAddressRightShifted);
+    return false;
+  }
+  Devices_[i2cAddressRightShifted] = device;
+  return true;
+}
+
+void SimI2CBus::AttachDevice(AddressMatcher matcher, Device* device) {
+  MatcherDevices_.emplace_back(std::move(matcher), device);
+}
+
+void SimI2CBus::DetachDevice(Device* device) {
+  std::replace(Devices_.begin(), Devices_.end(), device, static_cast<Device*>(nullptr));
+  std::erase_if(MatcherDevices_, [device](const auto& entry) { return entry.second == device; });
+  if (Selected_ == device) {
+    Selected_ = nullptr;
+  }
+}
+
+void SimI2CBus::AddObserver(Observer* observer) {
+  if (Observers_.empty()) {
+    // Replies are only watched while somebody is listening. Watching the TWI input rather than our
+    // own output also catches replies from devices that are not on this bus, such as the DS3231.
+    avr_irq_register_notify(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT), ToAvrCb,
+                            &Observers_);
+  }
+  Observers_.push_back(observer);
+}
+
+void SimI2CBus::RemoveObserver(Observer* observer) {
+  std::erase(Observers_, observer);
+  if (Observers_.empty()) {
+    avr_irq_unregister_notify(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT), ToAvrCb,
+                              &Observers_);
+  }
+}
+
+void SimI2CBus::SendToAvr(uint32_t value) {
+  avr_raise_irq(&MyIrqs_[MyIrqType::Output], value);
+}
+
+bool SimI2CBus::IsSelected(const Device* device) const {
+  return Selected_ == device;
+}
+
+void SimI2CBus::SetSelected(Device* device) {
+  Selected_ = device;
+}
+
+SimI2CBus::Device* SimI2CBus::FindDevice(avr_twi_msg_t msg) const {
+  if (auto device = Devices_[(msg.addr >> 1) & 0x7F]) {
+    return device;
+  }
+  for (auto& [matcher, device] : MatcherDevices_) {
+    if (matcher(&msg)) {
+      return device;
+    }
+  }
+  return nullptr;
+}
+
+void SimI2CBus::HandleMessageFromAvr(const avr_twi_msg_t& msg) {
+  for (auto observer : Observers_) {
+    observer->OnMessageFromAvr(msg);
+  }
+
+  if (msg.msg & TWI_COND_START) {
+    Device* device = FindDevice(msg);
+    if (Selected_ && Selected_ != device) {
+      Selected_->OnI2cBusDeselected();
+    }
+    Selected_ = device;
+  }
+
+  Device* device = Selected_;
+  if (msg.msg & TWI_COND_STOP) {
+    Selected_ = nullptr;
+  }
+  if (device) {
+    device->OnI2cBusMessage(msg);
+  }
+}
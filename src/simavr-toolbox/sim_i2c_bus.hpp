@@ -0,0 +1,78 @@
+#pragma once
+
+#include <simavr/avr_twi.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_irq.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Routes the AVR's TWI traffic to the simulated devices on the bus. The bus owns the connection
+// to TWI 0, looks the device up by address at START and hands every following message straight
+// to it until the next START or STOP, so a byte costs the same however many devices are attached.
+class SimI2CBus {
+ public:
+  class Device {
+   public:
+    virtual ~Device() = default;
+    // A message from the AVR while this device is selected.
+    virtual void OnI2cBusMessage(const avr_twi_msg_t& msg) = 0;
+    // A START for another address arrived while this device was selected.
+    virtual void OnI2cBusDeselected() {}
+  };
+
+  // Sees all traffic on the bus, in both directions, whether or not a device answers.
+  class Observer {
+   public:
+    virtual ~Observer() = default;
+    virtual void OnMessageFromAvr(const avr_twi_msg_t& msg) {}
+    virtual void OnMessageToAvr(const avr_twi_msg_t& msg) {}
+  };
+
+  using AddressMatcher = std::function<bool(avr_twi_msg_t*)>;
+
+  // The bus of TWI 0 on avr, shared by all devices attached to it.
+  static std::shared_ptr<SimI2CBus> Get(avr_t* avr);
+
+  explicit SimI2CBus(avr_t* avr);
+  ~SimI2CBus();
+  SimI2CBus(const SimI2CBus&) = delete;
+  SimI2CBus& operator=(const SimI2CBus&) = delete;
+
+  // Refuses, logging why, an address that is out of range or already taken. The refused device
+  // hears nothing.
+  bool AttachDevice(uint8_t i2cAddressRightShifted, Device* device);
+  // Devices that answer more than one address are matched at START, after the address table.
+  void AttachDevice(AddressMatcher matcher, Device* device);
+  void DetachDevice(Device* device);
+
+  void AddObserver(Observer* observer);
+  void RemoveObserver(Observer* observer);
+
+  // Raise a reply from a device, as built by avr_twi_irq_msg().
+  void SendToAvr(uint32_t value);
+
+  // Route a message as if the AVR had put it on the bus.
+  void HandleMessageFromAvr(const avr_twi_msg_t& msg);
+
+  // The device the current transaction is addressed to, so snapshots can put a transaction back.
+  bool IsSelected(const Device* device) const;
+  void SetSelected(Device* device);
+
+ private:
+  Device* FindDevice(avr_twi_msg_t msg) const;
+
+  enum MyIrqType { Input = 0, Output, Count };
+  static const char* irq_names[MyIrqType::Count];
+
+  avr_t* Avr_{nullptr};
+  avr_irq_t* MyIrqs_{nullptr};
+  std::array<Device*, 128> Devices_{};
+  std::vector<std::pair<AddressMatcher, Device*>> MatcherDevices_;
+  Device* Selected_{nullptr};
+  std::vector<Observer*> Observers_;
+};
@@ -0,0 +1,100 @@
+#include "sim_i2c_capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+SimI2CCapture::SimI2CCapture(const Config& config)
+    : Headers_(std::max<size_t>(config.Transactions, 1)),
+      Arena_(std::max(config.PayloadBytes, 2 * kMaxPayload)) {}
+
+void SimI2CCapture::Start(avr_cycle_count_t cycle, uint8_t address) {
+  if (InTransaction_) {
+    // A repeated start carries on the same transaction.
+    Current_.Flags |= kRepeatedStart;
+    return;
+  }
+  InTransaction_ = true;
+  Current_ = {};
+  Current_.StartCycle = cycle;
+  Current_.Address = address;
+}
+
+void SimI2CCapture::AddWrite(uint8_t data) {
+  Current_.Flags |= kWrite;
+  if (Current_.WriteLength == kMaxPayload) {
+    Current_.Flags |= kTruncated;
+    return;
+  }
+  WriteScratch_[Current_.WriteLength++] = data;
+}
+
+void SimI2CCapture::MarkRead() {
+  Current_.Flags |= kRead;
+}
+
+void SimI2CCapture::AddRead(uint8_t data) {
+  if (Current_.ReadLength == kMaxPayload) {
+    Current_.Flags |= kTruncated;
+    return;
+  }
+  ReadScratch_[Current_.ReadLength++] = data;
+}
+
+void SimI2CCapture::Stop(avr_cycle_count_t cycle) {
+  if (!InTransaction_) {
+    return;
+  }
+  InTransaction_ = false;
+  Current_.StopCycle = cycle;
+
+  // Keep the payload in one piece: if it would run off the end of the arena, start it again at the
+  // beginning and leave the tail unused.
+  const size_t length = Current_.WriteLength + Current_.ReadLength;
+  size_t offset = ArenaHead_ % Arena_.size();
+  if (offset + length > Arena_.size()) {
+    ArenaHead_ += Arena_.size() - offset;
+    offset = 0;
+  }
+  Current_.PayloadPosition = ArenaHead_;
+  std::memcpy(Arena_.data() + offset, WriteScratch_.data(), Current_.WriteLength);
+  std::memcpy(Arena_.data() + offset + Current_.WriteLength, ReadScratch_.data(),
+              Current_.ReadLength);
+  ArenaHead_ += length;
+
+  Headers_[Next_ % Headers_.size()] = Current_;
+  ++Next_;
+
+  // Drop whatever has been overwritten, in either ring.
+  if (Next_ - Oldest_ > Headers_.size()) {
+    Oldest_ = Next_ - Headers_.size();
+  }
+  while (Oldest_ < Next_ &&
+         Headers_[Oldest_ % Headers_.size()].PayloadPosition + Arena_.size() < ArenaHead_) {
+    ++Oldest_;
+  }
+}
+
+std::optional<SimI2CCapture::Record> SimI2CCapture::Get(uint64_t sequence) const {
+  if (sequence < Oldest_ || sequence >= Next_) {
+    return std::nullopt;
+  }
+  return MakeRecord(sequence);
+}
+
+void SimI2CCapture::Clear() {
+  Oldest_ = Next_;
+}
+
+SimI2CCapture::Record SimI2CCapture::MakeRecord(uint64_t sequence) const {
+  const Header& header = Headers_[sequence % Headers_.size()];
+  const uint8_t* payload = Arena_.data() + header.PayloadPosition % Arena_.size();
+  return {
+      .Sequence = sequence,
+      .Address = header.Address,
+      .Flags = header.Flags,
+      .StartCycle = header.StartCycle,
+      .StopCycle = header.StopCycle,
+      .Write = {payload, header.WriteLength},
+      .Read = {payload + header.WriteLength, header.ReadLength},
+  };
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Records I2C transactions into two rings allocated up front: one of fixed-size headers, and a
+// byte arena holding each transaction's payload in one piece. Capturing never allocates, however
+// deep the rings are; once either ring is full the oldest transactions are dropped to make room.
+//
+// Records are numbered from 0 in the order they finished. Views handed out by Get() and ForEach()
+// point into the rings and are only good until the next transaction is captured. Everything here
+// belongs to the simulation thread.
+class SimI2CCapture {
+ public:
+  struct Config {
+    size_t Transactions{1 << 16};
+    size_t PayloadBytes{1 << 20};
+  };
+
+  enum Flags : uint8_t {
+    kWrite = 1 << 0,
+    kRead = 1 << 1,
+    kRepeatedStart = 1 << 2,
+    // More bytes went by in one direction than kMaxPayload.
+    kTruncated = 1 << 3,
+  };
+
+  // Bytes kept per direction per transaction.
+  static constexpr size_t kMaxPayload = 4096;
+
+  struct Header {
+    avr_cycle_count_t StartCycle;
+    avr_cycle_count_t StopCycle;
+    // Where the payload starts, counted in bytes ever written to the arena.
+    uint64_t PayloadPosition;
+    uint16_t WriteLength;
+    uint16_t ReadLength;
+    uint8_t Address;
+    uint8_t Flags;
+  };
+
+  struct Record {
+    uint64_t Sequence;
+    uint8_t Address;
+    uint8_t Flags;
+    avr_cycle_count_t StartCycle;
+    avr_cycle_count_t StopCycle;
+    std::span<const uint8_t> Write;
+    std::span<const uint8_t> Read;
+  };
+
+  SimI2CCapture() : SimI2CCapture(Config{}) {}
+  // The arena is never smaller than two full transactions.
+  explicit SimI2CCapture(const Config& config);
+
+  // Feeding a transaction in, as it goes by on the bus.
+  void Start(avr_cycle_count_t cycle, uint8_t address);
+  void AddWrite(uint8_t data);
+  void MarkRead();
+  void AddRead(uint8_t data);
+  void Stop(avr_cycle_count_t cycle);
+  bool InTransaction() const { return InTransaction_; }
+
+  // Records still held are numbered [OldestSequence(), NextSequence()).
+  uint64_t OldestSequence() const { return Oldest_; }
+  uint64_t NextSequence() const { return Next_; }
+  size_t Size() const { return Next_ - Oldest_; }
+  std::optional<Record> Get(uint64_t sequence) const;
+  template <class Fn>
+  void ForEach(Fn&& fn) const {
+    for (uint64_t sequence = Oldest_; sequence < Next_; ++sequence) {
+      fn(MakeRecord(sequence));
+    }
+  }
+  void Clear();
+
+ private:
+  Record MakeRecord(uint64_t sequence) const;
+
+  std::vector<Header> Headers_;
+  std::vector<uint8_t> Arena_;
+  uint64_t Oldest_{0};
+  uint64_t Next_{0};
+  uint64_t ArenaHead_{0};
+
+  bool InTransaction_{false};
+  Header Current_{};
+  std::array<uint8_t, kMaxPayload> WriteScratch_;
+  std::array<uint8_t, kMaxPayload> ReadScratch_;
+};
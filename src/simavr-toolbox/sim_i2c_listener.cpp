@@ -5,39 +5,38 @@
 #include <cstdint>
 #include <simavr-toolbox/sim_base.hpp>
 
-avr_twi_msg_irq_t MakeTwiMsg(uint32_t value) {
-  avr_twi_msg_irq_t msg;
-  msg.u.v = value;
-  return msg;
+SimI2CListener::SimI2CListener(avr_t* avr)
+    : Avr_(avr),
+      Bus_(SimI2CBus::Get(avr)),
+      MessagesPublisher_(avr, [this] { MessagesSnapshot_.Publish(FinishedMessages_); }),
+      Stats_(avr) {
+  Bus_->AddObserver(this);
 }
 
-SimI2CListener::SimI2CListener(avr_t* avr) {
-  auto fromAvrCb = [](struct avr_irq_t* irq, uint32_t value, void* param) {
-    auto that = (SimI2CListener*)param;
-    that->OnMessageFromAvr(MakeTwiMsg(value));
-  };
-
-  auto toAvrCb = [](struct avr_irq_t* irq, uint32_t value, void* param) {
-    auto that = (SimI2CListener*)param;
-    that->OnMessageToAvr(MakeTwiMsg(value));
-  };
-
-  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), fromAvrCb,
-                          this);
-
-  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT), toAvrCb,
-                          this);
+SimI2CListener::SimI2CListener(avr_t* avr, const SimI2CCapture::Config& capture)
+    : SimI2CListener(avr) {
+  Capture_ = std::make_unique<SimI2CCapture>(capture);
 }
 
-void SimI2CListener::OnMessageFromAvr(const avr_twi_msg_irq_t& value) {
-  const avr_twi_msg_t msg = value.u.twi;
+SimI2CListener::~SimI2CListener() {
+  Bus_->RemoveObserver(this);
+}
 
+void SimI2CListener::OnMessageFromAvr(const avr_twi_msg_t& msg) {
+  if (Recording_.IsOpen()) {
+    Recording_.Append(Avr_->cycle, false, msg);
+  }
+  if (Capture_) {
+    CaptureMessageFromAvr(msg);
+    return;
+  }
   if (msg.msg & TWI_COND_START) {
     if (MessageInProgress_) {
       Check(0, msg.addr >> 1);
       MessageInProgress_->RepeatedStart = true;
     } else {
       MessageInProgress_.emplace(Message(msg.addr >> 1));
+      MessageInProgress_->StartCycle = Avr_->cycle;
     }
   } else if (msg.msg & TWI_COND_WRITE) {
     Check(1, msg.data);
@@ -52,10 +51,16 @@ void SimI2CListener::OnMessageFromAvr(const avr_twi_msg_irq_t& value) {
     }
   } else if (msg.msg & TWI_COND_STOP) {
     if (MessageInProgress_.has_value()) {
+      MessageInProgress_->StopCycle = Avr_->cycle;
+      Stats_.AddTransaction(MessageInProgress_->Address, MessageInProgress_->RepeatedStart,
+                            MessageInProgress_->WriteBuffer.size(),
+                            MessageInProgress_->ReadBuffer.size(), MessageInProgress_->StartCycle,
+                            MessageInProgress_->StopCycle);
       FinishedMessages_.push_front(*MessageInProgress_);
       while (FinishedMessages_.size() > 100) {
         FinishedMessages_.pop_back();
       }
+      MessagesPublisher_.MarkDirty();
       if (MessageCallbackFn_) {
         MessageCallbackFn_.value()(*MessageInProgress_);
       }
@@ -64,9 +69,44 @@ void SimI2CListener::OnMessageFromAvr(const avr_twi_msg_irq_t& value) {
   }
 }
 
-void SimI2CListener::OnMessageToAvr(const avr_twi_msg_irq_t& value) {
-  const avr_twi_msg_t msg = value.u.twi;
+void SimI2CListener::CaptureMessageFromAvr(const avr_twi_msg_t& msg) {
+  if (msg.msg & TWI_COND_START) {
+    Capture_->Start(Avr_->cycle, msg.addr >> 1);
+  } else if (msg.msg & TWI_COND_WRITE) {
+    Check(1, msg.data);
+    if (Capture_->InTransaction()) {
+      Capture_->AddWrite(msg.data);
+    }
+  } else if (msg.msg & TWI_COND_READ) {
+    Check(2, 0);
+    if (Capture_->InTransaction()) {
+      Capture_->MarkRead();
+    }
+  } else if (msg.msg & TWI_COND_STOP) {
+    if (!Capture_->InTransaction()) {
+      return;
+    }
+    Capture_->Stop(Avr_->cycle);
+    auto record = Capture_->Get(Capture_->NextSequence() - 1);
+    Stats_.AddTransaction(record->Address, record->Flags & SimI2CCapture::kRepeatedStart,
+                          record->Write.size(), record->Read.size(), record->StartCycle,
+                          record->StopCycle);
+  }
+}
 
+void SimI2CListener::OnMessageToAvr(const avr_twi_msg_t& msg) {
+  if (Recording_.IsOpen()) {
+    Recording_.Append(Avr_->cycle, true, msg);
+  }
+  if (Capture_) {
+    if (msg.msg & TWI_COND_READ) {
+      Check(3, msg.data);
+      if (Capture_->InTransaction()) {
+        Capture_->AddRead(msg.data);
+      }
+    }
+    return;
+  }
   if (msg.msg & TWI_COND_READ) {
     Check(3, msg.data);
     MessageInProgress_->ReadBuffer.push_back(msg.data);
@@ -74,8 +114,9 @@ void SimI2CListener::OnMessageToAvr(const avr_twi_msg_irq_t& value) {
 }
 
 void SimI2CListener::Check(int i, uint8_t data) {
-  if (!MessageInProgress_.has_value()) {
-    sim_debug_log("BAD I2C: %d ---> %d\n", i, (int)data);
+  bool inProgress = Capture_ ? Capture_->InTransaction() : MessageInProgress_.has_value();
+  if (!inProgress) {
+    sim_log(Avr_, SimLogLevel::Warning, "BAD I2C: %d ---> %d\n", i, (int)data);
   }
 }
 
@@ -83,6 +124,30 @@ const SimI2CListener::FinishedMessages& SimI2CListener::GetFinishedMessages() co
   return FinishedMessages_;
 }
 
+SimSnapshot<SimI2CListener::FinishedMessages>& SimI2CListener::GetMessagesSnapshot() {
+  return MessagesSnapshot_;
+}
+
 void SimI2CListener::OnMessage(MessageCallbackFn fn) {
   MessageCallbackFn_ = fn;
 }
+
+const SimI2CCapture* SimI2CListener::GetCapture() const {
+  return Capture_.get();
+}
+
+bool SimI2CListener::RecordTo(const char* path) {
+  return Recording_.Open(path, Avr_->frequency);
+}
+
+bool SimI2CListener::StopRecording() {
+  return Recording_.Close();
+}
+
+const SimI2CStats& SimI2CListener::GetStats() const {
+  return Stats_;
+}
+
+SimI2CStats& SimI2CListener::GetStats() {
+  return Stats_;
+}
@@ -3,13 +3,23 @@
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <optional>
-#include <simavr-toolbox/sim_i2c_base.hpp>
+#include <simavr-toolbox/sim_i2c_bus.hpp>
+#include <simavr-toolbox/sim_i2c_capture.hpp>
+#include <simavr-toolbox/sim_i2c_recording.hpp>
+#include <simavr-toolbox/sim_i2c_stats.hpp>
+#include <simavr-toolbox/sim_snapshot.hpp>
 #include <vector>
 
-class SimI2CListener {
+class SimI2CListener : private SimI2CBus::Observer {
  public:
+  // Keeps the last 100 transactions as Messages, for display.
   SimI2CListener(avr_t* avr);
+  // Records every transaction into a SimI2CCapture instead, without allocating. Messages,
+  // their snapshot and OnMessage() callbacks are not produced in this mode.
+  SimI2CListener(avr_t* avr, const SimI2CCapture::Config& capture);
+  ~SimI2CListener();
 
   enum class MessageType {
     Read,
@@ -18,9 +28,12 @@ class SimI2CListener {
 
   struct Message {
     Message(uint8_t address) : Address{address} {}
-    const uint8_t Address;
+    uint8_t Address;
     std::optional<MessageType> Type;
     bool RepeatedStart{false};
+    // Cycles of the first START and of the STOP.
+    avr_cycle_count_t StartCycle{0};
+    avr_cycle_count_t StopCycle{0};
     std::vector<uint8_t> WriteBuffer;
     std::vector<uint8_t> ReadBuffer;
     auto operator<=>(const Message&) const = default;
@@ -30,14 +43,35 @@ class SimI2CListener {
   using MessageCallbackFn = std::function<void(const Message&)>;
 
   const FinishedMessages& GetFinishedMessages() const;
+  // GetFinishedMessages() for the UI thread, published at most once per frame.
+  SimSnapshot<FinishedMessages>& GetMessagesSnapshot();
   void OnMessage(MessageCallbackFn fn);
+  // Null unless constructed in capture mode.
+  const SimI2CCapture* GetCapture() const;
+
+  // Also append every message, in both directions, to a recording file for SimI2CReplay. Works in
+  // either mode. Returns false if the file could not be created, or, from StopRecording(), written.
+  bool RecordTo(const char* path);
+  bool StopRecording();
+
+  // Kept in either mode, over the default window.
+  const SimI2CStats& GetStats() const;
+  SimI2CStats& GetStats();
 
  private:
-  void OnMessageFromAvr(const avr_twi_msg_irq_t& value);
-  void OnMessageToAvr(const avr_twi_msg_irq_t& value);
+  void OnMessageFromAvr(const avr_twi_msg_t& msg) override;
+  void OnMessageToAvr(const avr_twi_msg_t& msg) override;
   void Check(int i, uint8_t data);
+  void CaptureMessageFromAvr(const avr_twi_msg_t& msg);
 
+  avr_t* Avr_{nullptr};
+  std::shared_ptr<SimI2CBus> Bus_;
   FinishedMessages FinishedMessages_;
   std::optional<Message> MessageInProgress_;
   std::optional<MessageCallbackFn> MessageCallbackFn_;
+  SimSnapshot<FinishedMessages> MessagesSnapshot_;
+  SimSnapshotPublisher MessagesPublisher_;
+  std::unique_ptr<SimI2CCapture> Capture_;
+  SimI2CRecordingWriter Recording_;
+  SimI2CStats Stats_;
 };
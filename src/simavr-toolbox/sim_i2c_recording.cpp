@@ -0,0 +1,276 @@
+#include "sim_i2c_recording.hpp"
+
+#include <simavr/sim_cycle_timers.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace SimI2CRecordingFormat;
+
+static size_t RoundUpToPage(size_t bytes) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (bytes + page - 1) / page * page;
+}
+
+SimI2CRecordingWriter::~SimI2CRecordingWriter() {
+  Close();
+}
+
+bool SimI2CRecordingWriter::Open(const char* path, uint32_t frequency, size_t chunk_bytes) {
+  Close();
+  // The file header records the chunk size in 32 bits.
+  if (chunk_bytes > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  size_t rounded = RoundUpToPage(std::max(chunk_bytes, sizeof(ChunkHeader) + kMaxEventBytes));
+  if (rounded > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  Fd_ = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (Fd_ < 0) {
+    return false;
+  }
+  Failed_ = false;
+  Events_ = 0;
+  LastCycle_ = 0;
+  ChunkBytes_ = rounded;
+
+  FileHeader header{};
+  std::memcpy(header.Magic, kMagic, sizeof(kMagic));
+  header.ChunkBytes = ChunkBytes_;
+  header.Frequency = frequency;
+  header.FirstChunk = RoundUpToPage(sizeof(FileHeader));
+  if (pwrite(Fd_, &header, sizeof(header), 0) != sizeof(header) || !MapChunk(header.FirstChunk)) {
+    Failed_ = true;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool SimI2CRecordingWriter::MapChunk(uint64_t offset) {
+  if (ftruncate(Fd_, offset + ChunkBytes_) != 0) {
+    return false;
+  }
+  void* chunk = mmap(nullptr, ChunkBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, Fd_, offset);
+  if (chunk == MAP_FAILED) {
+    return false;
+  }
+  Chunk_ = static_cast<uint8_t*>(chunk);
+  ChunkOffset_ = offset;
+  // Fresh file space reads as zeroes, which is an empty chunk.
+  reinterpret_cast<ChunkHeader*>(Chunk_)->FirstCycle = LastCycle_;
+  reinterpret_cast<ChunkHeader*>(Chunk_)->LastCycle = LastCycle_;
+  return true;
+}
+
+void SimI2CRecordingWriter::UnmapChunk() {
+  if (Chunk_) {
+    munmap(Chunk_, ChunkBytes_);
+    Chunk_ = nullptr;
+  }
+}
+
+void SimI2CRecordingWriter::Append(avr_cycle_count_t cycle, bool to_avr,
+                                   const avr_twi_msg_t& msg) {
+  if (!Chunk_) {
+    return;
+  }
+  auto header = reinterpret_cast<ChunkHeader*>(Chunk_);
+  if (sizeof(ChunkHeader) + header->Used + kMaxEventBytes > ChunkBytes_) {
+    uint64_t next = ChunkOffset_ + ChunkBytes_;
+    UnmapChunk();
+    if (!MapChunk(next)) {
+      Failed_ = true;
+      return;
+    }
+    header = reinterpret_cast<ChunkHeader*>(Chunk_);
+  }
+
+  uint8_t* p = Chunk_ + sizeof(ChunkHeader) + header->Used;
+  uint64_t delta = cycle - LastCycle_;
+  while (delta >= 0x80) {
+    *p++ = static_cast<uint8_t>(delta) | 0x80;
+    delta >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(delta);
+  *p++ = (msg.msg & ~kToAvr) | (to_avr ? kToAvr : 0);
+  *p++ = msg.addr;
+  *p++ = msg.data;
+
+  header->Used = p - (Chunk_ + sizeof(ChunkHeader));
+  header->LastCycle = cycle;
+  header->Events++;
+  LastCycle_ = cycle;
+  Events_++;
+}
+
+bool SimI2CRecordingWriter::Close() {
+  if (Fd_ < 0) {
+    return !Failed_;
+  }
+  bool ok = !Failed_;
+  if (Chunk_) {
+    auto header = reinterpret_cast<ChunkHeader*>(Chunk_);
+    uint64_t end = ChunkOffset_ + sizeof(ChunkHeader) + header->Used;
+    UnmapChunk();
+    ok = ftruncate(Fd_, end) == 0 && ok;
+  }
+  ok = close(Fd_) == 0 && ok;
+  Fd_ = -1;
+  return ok;
+}
+
+SimI2CRecording::~SimI2CRecording() {
+  if (Data_) {
+    munmap(const_cast<uint8_t*>(Data_), Size_);
+  }
+}
+
+bool SimI2CRecording::Open(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  void* data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(FileHeader)) {
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  // Only what the writer produces: page-aligned chunks, the first of them right after the header
+  // and inside the file.
+  auto header = static_cast<const FileHeader*>(data);
+  if (std::memcmp(header->Magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->ChunkBytes <= sizeof(ChunkHeader) ||
+      header->ChunkBytes != RoundUpToPage(header->ChunkBytes) ||
+      header->FirstChunk != RoundUpToPage(sizeof(FileHeader)) ||
+      header->FirstChunk + sizeof(ChunkHeader) > static_cast<uint64_t>(st.st_size)) {
+    munmap(data, st.st_size);
+    return false;
+  }
+  if (Data_) {
+    munmap(const_cast<uint8_t*>(Data_), Size_);
+  }
+  Data_ = static_cast<const uint8_t*>(data);
+  Size_ = st.st_size;
+  FirstChunk_ = header->FirstChunk;
+  ChunkBytes_ = header->ChunkBytes;
+  Frequency_ = header->Frequency;
+  return true;
+}
+
+uint32_t SimI2CRecording::GetFrequency() const {
+  return Frequency_;
+}
+
+bool SimI2CRecording::ChunkEnd(uint64_t offset, const uint8_t*& end) const {
+  if (offset + sizeof(ChunkHeader) > Size_) {
+    return false;
+  }
+  auto header = reinterpret_cast<const ChunkHeader*>(Data_ + offset);
+  uint64_t used = offset + sizeof(ChunkHeader) + header->Used;
+  if (used > Size_ || sizeof(ChunkHeader) + header->Used > ChunkBytes_) {
+    return false;
+  }
+  end = Data_ + used;
+  return true;
+}
+
+bool SimI2CRecording::DecodeEvent(const uint8_t*& p, const uint8_t* end, Event& event) {
+  uint64_t delta = 0;
+  for (int shift = 0;; shift += 7) {
+    if (p == end || shift > 63) {
+      return false;
+    }
+    uint8_t byte = *p++;
+    delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  if (end - p < 3) {
+    return false;
+  }
+  event.Cycle += delta;
+  event.ToAvr = p[0] & kToAvr;
+  event.Msg = {};
+  event.Msg.msg = p[0] & ~kToAvr;
+  event.Msg.addr = p[1];
+  event.Msg.data = p[2];
+  p += 3;
+  return true;
+}
+
+SimI2CReplay::SimI2CReplay(avr_t* avr)
+    : Avr_(avr),
+      Bus_(SimI2CBus::Get(avr)),
+      TwiInput_(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT)) {
+  avr_irq_register_notify(TwiInput_, OnReply, this);
+}
+
+SimI2CReplay::~SimI2CReplay() {
+  avr_irq_unregister_notify(TwiInput_, OnReply, this);
+}
+
+void SimI2CReplay::OnReply(struct avr_irq_t* irq, uint32_t value, void* param) {
+  auto that = (SimI2CReplay*)param;
+  avr_twi_msg_irq_t msg;
+  msg.u.v = value;
+  if (msg.u.twi.msg & TWI_COND_READ) {
+    that->HasReadReply_ = true;
+    that->ReadReply_ = msg.u.twi.data;
+  }
+}
+
+SimI2CReplay::Result SimI2CReplay::Run(const SimI2CRecording& recording) {
+  Result result;
+  bool first = true;
+  avr_cycle_count_t shift = 0;
+  bool in_transaction = false;
+  HasReadReply_ = false;
+
+  bool complete = recording.ForEach([&](const SimI2CRecording::Event& event) {
+    if (first) {
+      shift = Avr_->cycle - event.Cycle;
+      first = false;
+    }
+    avr_cycle_count_t cycle = event.Cycle + shift;
+    if (cycle > Avr_->cycle) {
+      Avr_->cycle = cycle;
+      avr_cycle_timer_process(Avr_);
+    }
+
+    if (event.ToAvr) {
+      if (event.Msg.msg & TWI_COND_READ) {
+        result.Reads++;
+        if (!HasReadReply_ || ReadReply_ != event.Msg.data) {
+          result.ReadMismatches++;
+        }
+        HasReadReply_ = false;
+      }
+      return;
+    }
+
+    result.Messages++;
+    if ((event.Msg.msg & TWI_COND_START) && !in_transaction) {
+      result.Transactions++;
+      in_transaction = true;
+    } else if (event.Msg.msg & TWI_COND_STOP) {
+      in_transaction = false;
+    }
+    Bus_->HandleMessageFromAvr(event.Msg);
+  });
+  result.Truncated = !complete;
+  return result;
+}
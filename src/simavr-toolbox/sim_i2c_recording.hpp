@@ -0,0 +1,163 @@
+#pragma once
+
+#include <simavr/avr_twi.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_irq.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <simavr-toolbox/sim_i2c_bus.hpp>
+
+// Recording file layout, in native byte order:
+//   FileHeader, padded out to FirstChunk
+//   chunks, each ChunkBytes apart: ChunkHeader, then Used bytes of events
+// An event is the cycle delta from the previous event in its chunk (from FirstCycle for the first)
+// as an LEB128 varint, then one byte of TWI_COND_* flags with kToAvr set on replies, then the
+// address and data bytes. Each chunk decodes on its own. The last chunk is cut short at Close(),
+// and headers are kept up to date on every append, so the file of a run that died is still good
+// up to its last message.
+namespace SimI2CRecordingFormat {
+
+constexpr char kMagic[8] = {'S', 'I', 'M', 'I', '2', 'C', '1', '\0'};
+constexpr uint8_t kToAvr = 0x80;
+// Varint delta plus flags, address and data.
+constexpr size_t kMaxEventBytes = 10 + 3;
+
+struct FileHeader {
+  char Magic[8];
+  uint32_t ChunkBytes;
+  uint32_t Frequency;
+  uint64_t FirstChunk;
+};
+
+struct ChunkHeader {
+  uint32_t Used;
+  uint32_t Events;
+  avr_cycle_count_t FirstCycle;
+  avr_cycle_count_t LastCycle;
+};
+
+}  // namespace SimI2CRecordingFormat
+
+// Appends TWI messages to a recording file through a memory mapping of the chunk being filled, so
+// recording a message is a few stores. SimI2CListener::RecordTo() feeds one from the bus.
+class SimI2CRecordingWriter {
+ public:
+  // Chunks are rounded up to whole pages.
+  static constexpr size_t kDefaultChunkBytes = 1 << 20;
+
+  SimI2CRecordingWriter() = default;
+  ~SimI2CRecordingWriter();
+  SimI2CRecordingWriter(const SimI2CRecordingWriter&) = delete;
+  SimI2CRecordingWriter& operator=(const SimI2CRecordingWriter&) = delete;
+
+  // Returns false if the file could not be created, or if chunk_bytes does not fit the header's
+  // 32-bit field.
+  bool Open(const char* path, uint32_t frequency, size_t chunk_bytes = kDefaultChunkBytes);
+  // Messages must come in cycle order. Does nothing once the file has failed to grow.
+  void Append(avr_cycle_count_t cycle, bool to_avr, const avr_twi_msg_t& msg);
+  // Returns false if anything could not be written since Open().
+  bool Close();
+
+  bool IsOpen() const { return Fd_ >= 0; }
+  uint64_t GetEventCount() const { return Events_; }
+
+ private:
+  bool MapChunk(uint64_t offset);
+  void UnmapChunk();
+
+  int Fd_{-1};
+  bool Failed_{false};
+  size_t ChunkBytes_{0};
+  uint64_t ChunkOffset_{0};
+  uint8_t* Chunk_{nullptr};
+  avr_cycle_count_t LastCycle_{0};
+  uint64_t Events_{0};
+};
+
+// A recording file mapped read-only.
+class SimI2CRecording {
+ public:
+  struct Event {
+    avr_cycle_count_t Cycle;
+    // A reply from a device rather than a message from the AVR.
+    bool ToAvr;
+    avr_twi_msg_t Msg;
+  };
+
+  SimI2CRecording() = default;
+  ~SimI2CRecording();
+  SimI2CRecording(const SimI2CRecording&) = delete;
+  SimI2CRecording& operator=(const SimI2CRecording&) = delete;
+
+  // Returns false if the file could not be read or is not a recording.
+  bool Open(const char* path);
+  uint32_t GetFrequency() const;
+
+  // Calls fn(const Event&) for every event, in order. Returns false if a damaged chunk cut the
+  // walk short.
+  template <class Fn>
+  bool ForEach(Fn&& fn) const {
+    for (uint64_t offset = FirstChunk_; offset < Size_; offset += ChunkBytes_) {
+      const uint8_t* chunk = Data_ + offset;
+      const uint8_t* end;
+      if (!ChunkEnd(offset, end)) {
+        return false;
+      }
+      auto header = reinterpret_cast<const SimI2CRecordingFormat::ChunkHeader*>(chunk);
+      const uint8_t* p = chunk + sizeof(SimI2CRecordingFormat::ChunkHeader);
+      Event event{.Cycle = header->FirstCycle};
+      for (uint32_t i = 0; i < header->Events; ++i) {
+        if (!DecodeEvent(p, end, event)) {
+          return false;
+        }
+        fn(static_cast<const Event&>(event));
+      }
+    }
+    return true;
+  }
+
+ private:
+  bool ChunkEnd(uint64_t offset, const uint8_t*& end) const;
+  static bool DecodeEvent(const uint8_t*& p, const uint8_t* end, Event& event);
+
+  const uint8_t* Data_{nullptr};
+  size_t Size_{0};
+  uint64_t FirstChunk_{0};
+  uint32_t ChunkBytes_{0};
+  uint32_t Frequency_{0};
+};
+
+// Plays the AVR's side of a recording into the devices on an AVR's I2C bus, at host speed and with
+// no firmware running; host them on a SimNullMcu. Simulated time is moved forward to each
+// message's cycle, shifted to start from the current cycle, so the devices' own timers fire as
+// they did in the recorded run. Bytes the devices read back are checked against the recorded ones.
+class SimI2CReplay {
+ public:
+  struct Result {
+    uint64_t Messages{0};
+    uint64_t Transactions{0};
+    uint64_t Reads{0};
+    // Recorded reads the devices answered differently, or not at all.
+    uint64_t ReadMismatches{0};
+    // The recording was damaged; everything up to the damage was replayed.
+    bool Truncated{false};
+  };
+
+  explicit SimI2CReplay(avr_t* avr);
+  ~SimI2CReplay();
+  SimI2CReplay(const SimI2CReplay&) = delete;
+  SimI2CReplay& operator=(const SimI2CReplay&) = delete;
+
+  Result Run(const SimI2CRecording& recording);
+
+ private:
+  static void OnReply(struct avr_irq_t* irq, uint32_t value, void* param);
+
+  avr_t* Avr_{nullptr};
+  std::shared_ptr<SimI2CBus> Bus_;
+  avr_irq_t* TwiInput_{nullptr};
+  bool HasReadReply_{false};
+  uint8_t ReadReply_{0};
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <simavr-toolbox/sim_i2c_transaction_base.hpp>
+#include <span>
+
+// How the register pointer of a register-based I2C device behaves. The first byte of every write
+// phase is the pointer; the bytes after it are written from the selected register onwards, and
+// reads continue from wherever the pointer was left.
+struct SimI2CRegisterLayout {
+  // Registers 0 to Count - 1 exist. Others read as 0 and ignore writes.
+  uint16_t Count;
+  // The pointer bits that select the register.
+  uint8_t AddressMask{0xFF};
+  // Pointer bits that turn on auto-increment for the rest of the transaction.
+  uint8_t AutoIncrementFlags{0};
+  // Or bits of a register that turn it on while they are set.
+  uint8_t AutoIncrementRegister{0};
+  uint8_t AutoIncrementRegisterBits{0};
+  // Auto-increment goes back to register 0 after this one.
+  uint8_t WrapAfter{0xFF};
+  // Store each written byte and run its hook as soon as the byte arrives, rather than when the
+  // write phase ends. See SimAvrI2CTransactionComponent::SetWriteEachByte().
+  bool WriteEachByte{false};
+};
+
+// Describes the registers that are not plain read/write registers resetting to 0.
+template <class Peripheral>
+struct SimI2CRegister {
+  using WriteHook = void (Peripheral::*)(uint8_t old_value, uint8_t new_value);
+  using ReadHook = void (Peripheral::*)();
+
+  uint8_t Address;
+  // Of consecutive registers sharing this description.
+  uint8_t Span{1};
+  uint8_t Reset{0};
+  // Bits the AVR can change; the others keep their value on a write.
+  uint8_t WriteMask{0xFF};
+  // Called once a write has been stored.
+  WriteHook OnWrite{nullptr};
+  // Called once the AVR has been given the value.
+  ReadHook OnRead{nullptr};
+};
+
+// A register table flattened into one entry per possible pointer value, so that the device never
+// has to range check the pointer. Build one with MakeSimI2CRegisterMap().
+template <class Peripheral>
+struct SimI2CRegisterMap {
+  static constexpr size_t kMaxDescriptions = 16;
+
+  SimI2CRegisterLayout Layout;
+  std::array<uint8_t, 256> Reset{};
+  std::array<uint8_t, 256> WriteMask{};
+  // One more than the index of the register's description in the hook tables, or 0 for none.
+  std::array<uint8_t, 256> Description{};
+  std::array<typename SimI2CRegister<Peripheral>::WriteHook, kMaxDescriptions> WriteHooks{};
+  std::array<typename SimI2CRegister<Peripheral>::ReadHook, kMaxDescriptions> ReadHooks{};
+};
+
+// Checks the table while building it. Declared as a constexpr variable, a bad table fails to
+// compile, naming the problem.
+template <class Peripheral, size_t N>
+constexpr SimI2CRegisterMap<Peripheral> MakeSimI2CRegisterMap(
+    const SimI2CRegisterLayout& layout, const SimI2CRegister<Peripheral> (&registers)[N]) {
+  // Member function pointers cannot be compared while compiling, so the hooks are copied as they
+  // are and checked for null when called.
+  if (N > SimI2CRegisterMap<Peripheral>::kMaxDescriptions) {
+    throw "register map: too many registers described";
+  }
+  if (layout.Count == 0 || layout.Count > 256) {
+    throw "register map: Count must be 1 to 256";
+  }
+  if (layout.Count > layout.AddressMask + 1u) {
+    throw "register map: AddressMask cannot reach every register";
+  }
+  if (layout.AutoIncrementFlags & layout.AddressMask) {
+    throw "register map: AutoIncrementFlags overlap AddressMask";
+  }
+  if (layout.WrapAfter >= layout.Count) {
+    throw "register map: WrapAfter is past the last register";
+  }
+  if (layout.AutoIncrementRegisterBits && layout.AutoIncrementRegister >= layout.Count) {
+    throw "register map: AutoIncrementRegister does not exist";
+  }
+
+  SimI2CRegisterMap<Peripheral> map{.Layout = layout};
+  for (size_t i = 0; i < layout.Count; ++i) {
+    map.WriteMask[i] = 0xFF;
+  }
+
+  std::array<bool, 256> described{};
+  for (size_t d = 0; d < N; ++d) {
+    const SimI2CRegister<Peripheral>& reg = registers[d];
+    if (reg.Span == 0 || reg.Address + reg.Span > layout.Count) {
+      throw "register map: register does not exist";
+    }
+    map.WriteHooks[d] = reg.OnWrite;
+    map.ReadHooks[d] = reg.OnRead;
+    for (size_t i = reg.Address; i < reg.Address + reg.Span; ++i) {
+      if (described[i]) {
+        throw "register map: register described twice";
+      }
+      described[i] = true;
+      map.Reset[i] = reg.Reset;
+      map.WriteMask[i] = reg.WriteMask;
+      map.Description[i] = d + 1;
+    }
+  }
+  return map;
+}
+
+// A register-based I2C device whose registers, reset values, write masks, pointer handling and
+// side effects all come from a `static const SimI2CRegisterMap<Peripheral> kRegisterMap` member,
+// defined constexpr after the class so that its hooks can be taken. Peripheral befriends this
+// class, and only supplies the hooks and whatever drives the registers from its own side.
+//
+// The register pointer and auto-increment are cleared at STOP.
+template <class Peripheral>
+class SimAvrI2CRegisterComponent : public SimAvrI2CTransactionComponent {
+ public:
+  SimAvrI2CRegisterComponent(avr_t* avr, uint8_t i2cAddressRightShifted)
+      : SimAvrI2CTransactionComponent(avr, i2cAddressRightShifted) {
+    Registers_ = Peripheral::kRegisterMap.Reset;
+    SetWriteEachByte(Map().Layout.WriteEachByte);
+  }
+
+  // The registers and the register pointer.
+  void SaveState(SimStateWriter& out) const override {
+    SimAvrI2CTransactionComponent::SaveState(out);
+    out.Write(Registers_);
+    out.Write(SelectedRegister_);
+    out.Write(PointerAutoIncrement_);
+  }
+
+  void RestoreState(SimStateReader& in) override {
+    SimAvrI2CTransactionComponent::RestoreState(in);
+    in.Read(Registers_);
+    in.Read(SelectedRegister_);
+    in.Read(PointerAutoIncrement_);
+  }
+
+ protected:
+  // Indexed by any pointer value. Writing here directly skips masks and hooks.
+  std::array<uint8_t, 256> Registers_;
+
+ private:
+  static constexpr const SimI2CRegisterMap<Peripheral>& Map() { return Peripheral::kRegisterMap; }
+
+  void OnWrite(std::span<const uint8_t> data) final {
+    if (Map().Layout.WriteEachByte) {
+      WriteByte(data.size() - 1, data.back());
+      return;
+    }
+    for (size_t i = 0; i < data.size(); ++i) {
+      WriteByte(i, data[i]);
+    }
+  }
+
+  // The first byte of a write phase is the pointer.
+  void WriteByte(size_t index, uint8_t byte) {
+    if (index == 0) {
+      SelectedRegister_ = byte & Map().Layout.AddressMask;
+      PointerAutoIncrement_ = byte & Map().Layout.AutoIncrementFlags;
+      return;
+    }
+    const uint8_t reg = SelectedRegister_;
+    const uint8_t old_value = Registers_[reg];
+    const uint8_t mask = Map().WriteMask[reg];
+    Registers_[reg] = (old_value & ~mask) | (byte & mask);
+    if (const uint8_t description = Map().Description[reg]) {
+      if (auto fn = Map().WriteHooks[description - 1]) {
+        (static_cast<Peripheral*>(this)->*fn)(old_value, Registers_[reg]);
+      }
+    }
+    AdvancePointer();
+  }
+
+  uint8_t OnRead() final {
+    const uint8_t reg = SelectedRegister_;
+    const uint8_t value = Registers_[reg];
+    if (const uint8_t description = Map().Description[reg]) {
+      if (auto fn = Map().ReadHooks[description - 1]) {
+        (static_cast<Peripheral*>(this)->*fn)();
+      }
+    }
+    AdvancePointer();
+    return value;
+  }
+
+  void OnStop() final {
+    SelectedRegister_ = 0;
+    PointerAutoIncrement_ = false;
+  }
+
+  void AdvancePointer() {
+    const SimI2CRegisterLayout& layout = Map().Layout;
+    if (PointerAutoIncrement_ ||
+        (Registers_[layout.AutoIncrementRegister] & layout.AutoIncrementRegisterBits)) {
+      SelectedRegister_ = SelectedRegister_ >= layout.WrapAfter ? 0 : SelectedRegister_ + 1;
+    }
+  }
+
+  uint8_t SelectedRegister_{0};
+  bool PointerAutoIncrement_{false};
+};
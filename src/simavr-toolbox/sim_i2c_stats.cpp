@@ -0,0 +1,124 @@
+#include "sim_i2c_stats.hpp"
+
+#include <simavr/sim_time.h>
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+void SimI2CStats::Histogram::Add(avr_cycle_count_t cycles) {
+  size_t bucket = cycles < 2 ? 0 : std::bit_width(cycles) - 1;
+  Buckets[std::min(bucket, kBuckets - 1)]++;
+}
+
+uint64_t SimI2CStats::Histogram::Count() const {
+  return std::accumulate(Buckets.begin(), Buckets.end(), uint64_t{0});
+}
+
+avr_cycle_count_t SimI2CStats::Histogram::Percentile(double fraction) const {
+  uint64_t count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    seen += Buckets[i];
+    if (seen >= wanted) {
+      return (avr_cycle_count_t{2} << i) - 1;
+    }
+  }
+  return (avr_cycle_count_t{2} << (kBuckets - 1)) - 1;
+}
+
+SimI2CStats::SimI2CStats(avr_t* avr, std::chrono::microseconds window)
+    : Avr_(avr) {
+  SlotCycles_ = std::max<avr_cycle_count_t>(1, avr_usec_to_cycles(avr, window.count()) / kSlots);
+}
+
+void SimI2CStats::AddTransaction(uint8_t address, bool repeated_start, size_t bytes_written,
+                                 size_t bytes_read, avr_cycle_count_t start,
+                                 avr_cycle_count_t stop) {
+  avr_cycle_count_t duration = stop > start ? stop - start : 0;
+  for (AddressStats* stats : {&Addresses_[address % kAddresses], &Totals_}) {
+    stats->Transactions++;
+    stats->WriteTransactions += bytes_written > 0;
+    stats->ReadTransactions += bytes_read > 0;
+    stats->BytesWritten += bytes_written;
+    stats->BytesRead += bytes_read;
+    stats->RepeatedStarts += repeated_start;
+    stats->BusyCycles += duration;
+    stats->Duration.Add(duration);
+  }
+
+  // The whole transaction is put in the slot it ended in; they are far shorter than a slot.
+  Slot& slot = GetSlot(stop);
+  slot.BusyCycles += duration;
+  slot.Transactions[address % kAddresses]++;
+}
+
+void SimI2CStats::Clear() {
+  Addresses_ = {};
+  Totals_ = {};
+  Slots_ = {};
+}
+
+const SimI2CStats::AddressStats& SimI2CStats::GetAddressStats(uint8_t address) const {
+  return Addresses_[address % kAddresses];
+}
+
+const SimI2CStats::AddressStats& SimI2CStats::GetTotals() const {
+  return Totals_;
+}
+
+SimI2CStats::Slot& SimI2CStats::GetSlot(avr_cycle_count_t cycle) {
+  uint64_t epoch = cycle / SlotCycles_;
+  Slot& slot = Slots_[epoch % kSlots];
+  if (slot.Epoch != epoch) {
+    slot = {};
+    slot.Epoch = epoch;
+  }
+  return slot;
+}
+
+template <class Fn>
+avr_cycle_count_t SimI2CStats::ForEachRecentSlot(avr_cycle_count_t now, Fn&& fn) const {
+  uint64_t epoch = now / SlotCycles_;
+  uint64_t oldest = epoch >= kSlots - 1 ? epoch - (kSlots - 1) : 0;
+  for (const Slot& slot : Slots_) {
+    // Slots the clock has gone back past, after a board restore, are counted until reused.
+    if (slot.Epoch >= oldest && slot.Epoch <= epoch) {
+      fn(slot);
+    }
+  }
+  return now - oldest * SlotCycles_;
+}
+
+uint64_t SimI2CStats::GetRecentTransactions(uint8_t address, avr_cycle_count_t now) const {
+  uint64_t transactions = 0;
+  ForEachRecentSlot(now, [&](const Slot& slot) {
+    transactions += slot.Transactions[address % kAddresses];
+  });
+  return transactions;
+}
+
+double SimI2CStats::GetRecentTransactionsPerSecond(uint8_t address, avr_cycle_count_t now) const {
+  uint64_t transactions = 0;
+  avr_cycle_count_t span = ForEachRecentSlot(now, [&](const Slot& slot) {
+    transactions += slot.Transactions[address % kAddresses];
+  });
+  if (span == 0) {
+    return 0;
+  }
+  return static_cast<double>(transactions) * Avr_->frequency / span;
+}
+
+double SimI2CStats::GetRecentBusyFraction(avr_cycle_count_t now) const {
+  avr_cycle_count_t busy = 0;
+  avr_cycle_count_t span =
+      ForEachRecentSlot(now, [&](const Slot& slot) { busy += slot.BusyCycles; });
+  if (span == 0) {
+    return 0;
+  }
+  return std::min(1.0, static_cast<double>(busy) / span);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Bus statistics per 7-bit address, in simulated time. Totals cover the whole run; the windowed
+// figures cover the last `window` of simulated time, kept in kSlots slots that are cleared as
+// simulated time moves past them, so a firmware polling a device too often shows up however long
+// the run. All storage is fixed at construction and adding a transaction costs a handful of stores.
+//
+// Fed by SimI2CListener at every STOP. Simulation thread only.
+class SimI2CStats {
+ public:
+  static constexpr size_t kAddresses = 128;
+  static constexpr size_t kSlots = 16;
+
+  // Transaction durations in cycles, in power of two buckets: bucket 0 holds 0 and 1, bucket i
+  // holds [2^i, 2^(i+1)), and the last bucket everything longer.
+  struct Histogram {
+    static constexpr size_t kBuckets = 32;
+    std::array<uint64_t, kBuckets> Buckets{};
+
+    void Add(avr_cycle_count_t cycles);
+    uint64_t Count() const;
+    // The upper bound of the bucket holding the given fraction of the samples, e.g. 0.99.
+    avr_cycle_count_t Percentile(double fraction) const;
+  };
+
+  struct AddressStats {
+    uint64_t Transactions{0};
+    uint64_t WriteTransactions{0};
+    uint64_t ReadTransactions{0};
+    uint64_t BytesWritten{0};
+    uint64_t BytesRead{0};
+    uint64_t RepeatedStarts{0};
+    // Cycles from START to STOP, summed and as a histogram.
+    avr_cycle_count_t BusyCycles{0};
+    Histogram Duration;
+  };
+
+  explicit SimI2CStats(avr_t* avr, std::chrono::microseconds window = std::chrono::seconds(1));
+
+  void AddTransaction(uint8_t address, bool repeated_start, size_t bytes_written,
+                      size_t bytes_read, avr_cycle_count_t start, avr_cycle_count_t stop);
+  void Clear();
+
+  const AddressStats& GetAddressStats(uint8_t address) const;
+  const AddressStats& GetTotals() const;
+
+  // Over the window ending at `now`, which is usually avr->cycle.
+  uint64_t GetRecentTransactions(uint8_t address, avr_cycle_count_t now) const;
+  double GetRecentTransactionsPerSecond(uint8_t address, avr_cycle_count_t now) const;
+  // Fraction of simulated time the bus spent between START and STOP, from 0 to 1.
+  double GetRecentBusyFraction(avr_cycle_count_t now) const;
+
+ private:
+  struct Slot {
+    // Which SlotCycles_-long span of simulated time the slot holds.
+    uint64_t Epoch{0};
+    avr_cycle_count_t BusyCycles{0};
+    std::array<uint32_t, kAddresses> Transactions{};
+  };
+
+  Slot& GetSlot(avr_cycle_count_t cycle);
+  // The slots inside the window ending at now, and the cycles that window spans so far.
+  template <class Fn>
+  avr_cycle_count_t ForEachRecentSlot(avr_cycle_count_t now, Fn&& fn) const;
+
+  avr_t* Avr_{nullptr};
+  avr_cycle_count_t SlotCycles_{1};
+  std::array<AddressStats, kAddresses> Addresses_;
+  AddressStats Totals_;
+  std::array<Slot, kSlots> Slots_;
+};
@@ -0,0 +1,74 @@
+#include "sim_i2c_transaction_base.hpp"
+
+#include <simavr/avr_twi.h>
+
+void SimAvrI2CTransactionComponent::HandleI2CMessage(const avr_twi_msg_t& msg) {
+  if (msg.msg & TWI_COND_START) {
+    bool repeated_start = InTransaction_;
+    FlushWrite();
+    InTransaction_ = true;
+    Ignoring_ = !OnStart(msg.addr & 1, repeated_start);
+    if (!Ignoring_) {
+      SendToAvrI2CAck();
+    }
+  } else if (!InTransaction_ || Ignoring_) {
+    // Not for us, or a STOP that has already ended the transaction through ResetStateMachine().
+  } else if (msg.msg & TWI_COND_WRITE) {
+    if (WriteLength_ == WriteBuffer_.size()) {
+      WriteBuffer_.resize(WriteBuffer_.size() * 2);
+    }
+    WriteBuffer_[WriteLength_++] = msg.data;
+    SendToAvrI2CAck();
+    if (WriteEachByte_) {
+      OnWrite({WriteBuffer_.data(), WriteLength_});
+    }
+  } else if (msg.msg & TWI_COND_READ) {
+    FlushWrite();
+    SendByteToAvrI2c(OnRead());
+  }
+}
+
+void SimAvrI2CTransactionComponent::ResetStateMachine() {
+  if (!InTransaction_) {
+    return;
+  }
+  bool ignoring = Ignoring_;
+  InTransaction_ = false;
+  Ignoring_ = false;
+  if (!ignoring) {
+    FlushWrite();
+    OnStop();
+  }
+  WriteLength_ = 0;
+}
+
+void SimAvrI2CTransactionComponent::FlushWrite() {
+  if (WriteLength_ == 0) {
+    return;
+  }
+  // Cleared first, so that the device may end the transaction from inside OnWrite().
+  size_t length = WriteLength_;
+  WriteLength_ = 0;
+  if (!Ignoring_ && !WriteEachByte_) {
+    OnWrite({WriteBuffer_.data(), length});
+  }
+}
+
+void SimAvrI2CTransactionComponent::SaveState(SimStateWriter& out) const {
+  SimAvrI2CComponent::SaveState(out);
+  out.Write(InTransaction_);
+  out.Write(Ignoring_);
+  out.Write<uint32_t>(WriteLength_);
+  out.Write(WriteBuffer_.data(), WriteLength_);
+}
+
+void SimAvrI2CTransactionComponent::RestoreState(SimStateReader& in) {
+  SimAvrI2CComponent::RestoreState(in);
+  in.Read(InTransaction_);
+  in.Read(Ignoring_);
+  WriteLength_ = in.Read<uint32_t>();
+  if (WriteLength_ > WriteBuffer_.size()) {
+    WriteBuffer_.resize(WriteLength_);
+  }
+  in.Read(WriteBuffer_.data(), WriteLength_);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <simavr-toolbox/sim_i2c_base.hpp>
+#include <span>
+#include <vector>
+
+// An I2C device that works in whole transactions instead of bus messages. The base acknowledges
+// the bus, collects the bytes of each write phase into a buffer that is kept from one transaction
+// to the next, and hands them over in one piece when the phase ends at a repeated START or STOP.
+// Bytes the AVR reads are pulled from the device one at a time, as it clocks them out. A typical
+// register device is then: OnWrite() selects a register and stores the rest, OnRead() returns the
+// selected register and moves on.
+class SimAvrI2CTransactionComponent : public SimAvrI2CComponent {
+ public:
+  using SimAvrI2CComponent::SimAvrI2CComponent;
+
+  void HandleI2CMessage(const avr_twi_msg_t& msg) final;
+  // Ends the transaction in progress, as a STOP would.
+  void ResetStateMachine() final;
+
+  // The transaction in progress, including bytes of a write phase not yet handed over.
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
+
+ protected:
+  // A START, or a repeated START, addressed to this device. Returning false leaves it
+  // unacknowledged, and the device hears nothing more until the next START.
+  virtual bool OnStart(bool read, bool repeated_start) { return true; }
+  // The bytes of a write phase, never empty. Only valid during the call.
+  virtual void OnWrite(std::span<const uint8_t> data) {}
+  // The next byte for the AVR to read.
+  virtual uint8_t OnRead() { return 0xFF; }
+  // The transaction has ended, after its last write phase has been handed over.
+  virtual void OnStop() {}
+
+  // Hand the write phase over after every byte instead of once at its end, for devices whose
+  // writes have effects the AVR can see before the STOP. OnWrite() then gets the phase so far,
+  // ending with the byte just acknowledged.
+  void SetWriteEachByte(bool each) { WriteEachByte_ = each; }
+
+ private:
+  void FlushWrite();
+
+  bool InTransaction_{false};
+  bool Ignoring_{false};
+  bool WriteEachByte_{false};
+  size_t WriteLength_{0};
+  // Grows to the longest write phase seen, and then stays that size.
+  std::vector<uint8_t> WriteBuffer_ = std::vector<uint8_t>(32);
+};
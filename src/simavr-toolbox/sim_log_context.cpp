@@ -0,0 +1,105 @@
+#include "sim_log_context.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <simavr-toolbox/sim_avr_registry.hpp>
+#include <utility>
+
+namespace {
+
+std::mutex gContextsMutex;
+std::map<avr_t*, SimLogContext*> gContexts;
+// Bumped whenever a context comes or goes, invalidating every thread's cached lookup.
+std::atomic<uint64_t> gContextsGeneration{1};
+
+// Boards run on one thread each, so a single remembered lookup per thread nearly always hits.
+struct CachedLookup {
+  avr_t* Avr{nullptr};
+  SimLogContext* Context{nullptr};
+  uint64_t Generation{0};
+};
+
+thread_local CachedLookup tCachedLookup;
+
+}  // namespace
+
+std::shared_ptr<SimLogContext> SimLogContext::Get(avr_t* avr) {
+  return GetPerAvrInstance<SimLogContext>(avr);
+}
+
+SimLogContext* SimLogContext::Find(avr_t* avr) {
+  CachedLookup& cache = tCachedLookup;
+  if (cache.Avr == avr &&
+      cache.Generation == gContextsGeneration.load(std::memory_order_acquire)) {
+    return cache.Context;
+  }
+
+  std::lock_guard lock(gContextsMutex);
+  auto it = gContexts.find(avr);
+  cache.Avr = avr;
+  cache.Context = it == gContexts.end() ? nullptr : it->second;
+  cache.Generation = gContextsGeneration.load(std::memory_order_relaxed);
+  return cache.Context;
+}
+
+SimLogContext::SimLogContext(avr_t* avr) : Avr_(avr) {
+  std::lock_guard lock(gContextsMutex);
+  gContexts[avr] = this;
+  gContextsGeneration.fetch_add(1, std::memory_order_release);
+}
+
+SimLogContext::~SimLogContext() {
+  std::lock_guard lock(gContextsMutex);
+  if (auto it = gContexts.find(Avr_); it != gContexts.end() && it->second == this) {
+    gContexts.erase(it);
+  }
+  gContextsGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void SimLogContext::SetSink(SinkFn sink) {
+  Sink_ = std::move(sink);
+}
+
+void SimLogContext::SetTextSink(TextSinkFn sink) {
+  if (!sink) {
+    Sink_ = nullptr;
+    return;
+  }
+  Sink_ = [this, sink = std::move(sink)](SimLogLevel level, const char* fmt, va_list args) {
+    int length = std::vsnprintf(Line_.data(), Line_.size(), fmt, args);
+    if (length < 0) {
+      return;
+    }
+    sink(level, std::string_view(Line_.data(), std::min<size_t>(length, Line_.size() - 1)));
+  };
+}
+
+const SimLogContext::SinkFn& SimLogContext::GetSink() const {
+  return Sink_;
+}
+
+void SimLogContext::SetLevelMask(uint32_t mask) {
+  LevelMask_ = mask;
+}
+
+uint32_t SimLogContext::GetLevelMask() const {
+  return LevelMask_;
+}
+
+bool SimLogContext::IsEnabled(SimLogLevel level) const {
+  return (LevelMask_ & SimLogMask(level)) != 0;
+}
+
+void SimLogContext::Log(SimLogLevel level, const char* fmt, va_list args) {
+  if (!IsEnabled(level)) {
+    return;
+  }
+  if (Sink_) {
+    Sink_(level, fmt, args);
+  } else {
+    get_sim_debug_log()(fmt, args);
+  }
+}
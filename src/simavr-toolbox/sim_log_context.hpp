@@ -0,0 +1,55 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <simavr-toolbox/sim_base.hpp>
+#include <string_view>
+
+// Logging state for one board: where its messages go, which levels are kept, and a line buffer for
+// sinks that want text. Boards without a context, and contexts without a sink, fall back to the
+// process-wide set_sim_debug_log() function, so existing setups keep working.
+//
+// A context is used from the thread that runs its board; boards on other threads have their own.
+class SimLogContext {
+ public:
+  static constexpr size_t kLineBytes = 256;
+
+  // Receives messages unformatted, for sinks that defer formatting.
+  using SinkFn = std::function<void(SimLogLevel level, const char* fmt, va_list args)>;
+  // Receives messages formatted into the context's line buffer, truncated to kLineBytes - 1.
+  using TextSinkFn = std::function<void(SimLogLevel level, std::string_view line)>;
+
+  // The context for avr, created on first use. It lives only as long as somebody holds on to it, so
+  // a sink set through a temporary is gone at the end of the statement. HeadlessRunner and
+  // SimNullMcu keep their board's context; use their Log().
+  static std::shared_ptr<SimLogContext> Get(avr_t* avr);
+  // The context for avr if it has one. Cheap enough to call for every message.
+  static SimLogContext* Find(avr_t* avr);
+
+  explicit SimLogContext(avr_t* avr);
+  ~SimLogContext();
+  SimLogContext(const SimLogContext&) = delete;
+  SimLogContext& operator=(const SimLogContext&) = delete;
+
+  // An empty sink sends messages to the process-wide function.
+  void SetSink(SinkFn sink);
+  void SetTextSink(TextSinkFn sink);
+  const SinkFn& GetSink() const;
+
+  // Bits from SimLogMask(); all levels are kept by default.
+  void SetLevelMask(uint32_t mask);
+  uint32_t GetLevelMask() const;
+  bool IsEnabled(SimLogLevel level) const;
+
+  void Log(SimLogLevel level, const char* fmt, va_list args);
+
+ private:
+  avr_t* Avr_{nullptr};
+  SinkFn Sink_;
+  uint32_t LevelMask_{kSimLogAllLevels};
+  std::array<char, kLineBytes> Line_{};
+};
@@ -0,0 +1,75 @@
+#include "sim_null_mcu.hpp"
+
+#include <simavr/sim_cycle_timers.h>
+
+#include <cstdlib>
+
+#include "sim_base.hpp"
+
+SimNullMcu::SimNullMcu(const char* mcu, uint32_t frequency) {
+  Avr_ = avr_make_mcu_by_name(mcu);
+  if (!Avr_) {
+    sim_log(nullptr, SimLogLevel::Error, "AVR '%s' not known\n", mcu);
+    std::abort();
+  }
+  avr_init(Avr_);
+  Avr_->frequency = frequency;
+  Log_ = SimLogContext::Get(Avr_);
+
+  TwiOutput_ = avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT);
+  avr_irq_register_notify(avr_io_getirq(Avr_, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT), OnReply,
+                          this);
+}
+
+SimNullMcu::~SimNullMcu() {
+  Log_.reset();
+  avr_terminate(Avr_);
+  free(Avr_);
+}
+
+avr_t* SimNullMcu::Avr() const {
+  return Avr_;
+}
+
+SimLogContext& SimNullMcu::Log() {
+  return *Log_;
+}
+
+void SimNullMcu::I2cStart(uint8_t address, bool read) {
+  avr_raise_irq(TwiOutput_, avr_twi_irq_msg(TWI_COND_START, (address << 1) | read, 0));
+}
+
+void SimNullMcu::I2cWrite(uint8_t address, uint8_t data) {
+  avr_raise_irq(TwiOutput_, avr_twi_irq_msg(TWI_COND_WRITE, address << 1, data));
+}
+
+void SimNullMcu::I2cRead(uint8_t address) {
+  avr_raise_irq(TwiOutput_, avr_twi_irq_msg(TWI_COND_READ, (address << 1) | 1, 0));
+}
+
+void SimNullMcu::I2cStop(uint8_t address) {
+  avr_raise_irq(TwiOutput_, avr_twi_irq_msg(TWI_COND_STOP, address << 1, 1));
+}
+
+uint64_t SimNullMcu::GetReplyCount() const {
+  return ReplyCount_;
+}
+
+uint8_t SimNullMcu::GetLastReadByte() const {
+  return LastReadByte_;
+}
+
+void SimNullMcu::Advance(avr_cycle_count_t cycles) {
+  Avr_->cycle += cycles;
+  avr_cycle_timer_process(Avr_);
+}
+
+void SimNullMcu::OnReply(struct avr_irq_t* irq, uint32_t value, void* param) {
+  auto that = (SimNullMcu*)param;
+  avr_twi_msg_irq_t msg;
+  msg.u.v = value;
+  that->ReplyCount_++;
+  if (msg.u.twi.msg & TWI_COND_READ) {
+    that->LastReadByte_ = msg.u.twi.data;
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <simavr/avr_twi.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_irq.h>
+
+#include <cstdint>
+#include <memory>
+#include <simavr-toolbox/sim_log_context.hpp>
+
+// A bare AVR core with no firmware loaded, for hosting peripheral models whose inputs are driven
+// directly instead of by running code. The TWI helpers play the part of the AVR's TWI master.
+class SimNullMcu {
+ public:
+  explicit SimNullMcu(const char* mcu = "atmega1284p", uint32_t frequency = 16000000);
+  ~SimNullMcu();
+  SimNullMcu(const SimNullMcu&) = delete;
+  SimNullMcu& operator=(const SimNullMcu&) = delete;
+
+  avr_t* Avr() const;
+  // The board's log context, kept for as long as the board.
+  SimLogContext& Log();
+
+  // Raise TWI master conditions as the AVR's TWI module would. Addresses are right shifted.
+  void I2cStart(uint8_t address, bool read);
+  void I2cWrite(uint8_t address, uint8_t data);
+  void I2cRead(uint8_t address);
+  void I2cStop(uint8_t address);
+
+  // Number of messages devices have sent back to the master, and the last byte read.
+  uint64_t GetReplyCount() const;
+  uint8_t GetLastReadByte() const;
+
+  // Move simulated time forward, firing any cycle timers that fall due.
+  void Advance(avr_cycle_count_t cycles);
+
+ private:
+  static void OnReply(struct avr_irq_t* irq, uint32_t value, void* param);
+
+  avr_t* Avr_{nullptr};
+  std::shared_ptr<SimLogContext> Log_;
+  avr_irq_t* TwiOutput_{nullptr};
+  uint64_t ReplyCount_{0};
+  uint8_t LastReadByte_{0};
+};
@@ -0,0 +1,42 @@
+#include "sim_snapshot.hpp"
+
+#include <simavr/sim_time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+SimSnapshotPublisher::SimSnapshotPublisher(avr_t* avr, PublishFn fn,
+                                           std::chrono::microseconds interval)
+    : Fn_(std::move(fn)),
+      Interval_(interval),
+      IntervalCycles_(std::max<avr_cycle_count_t>(1, avr_usec_to_cycles(avr, interval.count()))),
+      Timer_(avr, [this](avr_cycle_count_t when) { return OnTimer(when); }) {}
+
+void SimSnapshotPublisher::MarkDirty() {
+  // A pending publication is due within one interval, unless a board restore has wound the clock
+  // back past the cycle it was scheduled from; then it is pulled in.
+  avr_cycle_count_t status = Timer_.Status();
+  if (status == 0 || status > IntervalCycles_ + 1) {
+    Timer_.ScheduleIn(IntervalCycles_);
+  }
+}
+
+void SimSnapshotPublisher::Flush() {
+  Timer_.Cancel();
+  LastPublish_ = std::chrono::steady_clock::now();
+  Fn_();
+}
+
+avr_cycle_count_t SimSnapshotPublisher::OnTimer(avr_cycle_count_t when) {
+  auto now = std::chrono::steady_clock::now();
+  auto since = std::chrono::duration_cast<std::chrono::microseconds>(now - LastPublish_);
+  if (since < Interval_) {
+    // The simulation is running faster than real time; wait out the rest of the frame.
+    return when + std::max<avr_cycle_count_t>(
+                      1, IntervalCycles_ * (Interval_ - since).count() / Interval_.count());
+  }
+  LastPublish_ = now;
+  Fn_();
+  return 0;
+}
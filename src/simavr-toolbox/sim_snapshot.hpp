@@ -0,0 +1,80 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <simavr-toolbox/timer.hpp>
+
+// Hands immutable copies of device state from the simulation thread to one reader, normally the UI
+// thread, through a triple buffer. Neither side ever waits: Publish() fills the spare buffer and
+// swaps it in, Read() takes the newest published buffer if there is one and otherwise keeps the one
+// it has. Each version carries a generation number so the reader can tell whether anything changed.
+template <class T>
+class SimSnapshot {
+ public:
+  struct Version {
+    uint64_t Generation{0};
+    T Value{};
+  };
+
+  // Simulation thread only.
+  void Publish(const T& value) {
+    Version& back = Buffers_[Back_];
+    back.Value = value;
+    back.Generation = ++Generation_;
+    Back_ = Middle_.exchange(Back_ | kFresh, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Reader thread only. The reference stays valid until the next Read().
+  const Version& Read() {
+    if (Middle_.load(std::memory_order_relaxed) & kFresh) {
+      Front_ = Middle_.exchange(Front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    return Buffers_[Front_];
+  }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x03;
+  static constexpr uint8_t kFresh = 0x04;
+
+  std::array<Version, 3> Buffers_{};
+  alignas(64) std::atomic<uint8_t> Middle_{1};
+  alignas(64) uint8_t Back_{2};
+  uint64_t Generation_{0};
+  alignas(64) uint8_t Front_{0};
+};
+
+// Rate-limits snapshot publication for one device. The device calls MarkDirty() whenever its state
+// changes; the publish function then runs once, one frame interval of simulated time later and no
+// sooner than one interval of wall-clock time after the previous publication. Changes in between
+// are folded into that one copy.
+class SimSnapshotPublisher {
+ public:
+  using PublishFn = std::function<void()>;
+
+  static constexpr std::chrono::microseconds kDefaultInterval{16667};
+
+  SimSnapshotPublisher(avr_t* avr, PublishFn fn,
+                       std::chrono::microseconds interval = kDefaultInterval);
+  SimSnapshotPublisher(const SimSnapshotPublisher&) = delete;
+  SimSnapshotPublisher& operator=(const SimSnapshotPublisher&) = delete;
+
+  // O(1), so it can be called for every byte that changes the state.
+  void MarkDirty();
+
+  // Publish now, for example before handing the device to a UI for the first time.
+  void Flush();
+
+ private:
+  avr_cycle_count_t OnTimer(avr_cycle_count_t when);
+
+  PublishFn Fn_;
+  std::chrono::microseconds Interval_;
+  avr_cycle_count_t IntervalCycles_;
+  std::chrono::steady_clock::time_point LastPublish_;
+  SimTimer Timer_;
+};
@@ -0,0 +1,42 @@
+#include "sim_state.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <simavr-toolbox/sim_base.hpp>
+
+void SimStateReader::Read(void* data, size_t size) {
+  if (size > In_.size() - Position_) {
+    sim_log(Avr_, SimLogLevel::Error, "Snapshot too short: wanted %zu bytes at offset %zu of %zu\n",
+            size, Position_, In_.size());
+    std::abort();
+  }
+  if (size == 0) {
+    return;
+  }
+  std::memcpy(data, In_.data() + Position_, size);
+  Position_ += size;
+}
+
+void SimSaveTimer(SimStateWriter& out, const SimTimer& timer) {
+  // One more than the cycles left to run, or 0 when the timer is not pending.
+  out.Write(timer.Status());
+}
+
+void SimRestoreTimer(SimStateReader& in, SimTimer& timer) {
+  if (auto status = in.Read<avr_cycle_count_t>()) {
+    timer.ScheduleIn(status - 1);
+  } else {
+    timer.Cancel();
+  }
+}
+
+void SimSaveIrqValue(SimStateWriter& out, const avr_irq_t* irq) {
+  out.Write<uint32_t>(irq ? irq->value : 0);
+}
+
+void SimRestoreIrqValue(SimStateReader& in, avr_irq_t* irq) {
+  auto value = in.Read<uint32_t>();
+  if (irq) {
+    irq->value = value;
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_irq.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <simavr-toolbox/timer.hpp>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Appends a peripheral's state to a byte buffer. Values are stored in host byte order; a snapshot
+// is only meant to be restored by the same build on the same machine.
+class SimStateWriter {
+ public:
+  explicit SimStateWriter(std::vector<uint8_t>& out) : Out_(out) {}
+
+  void Write(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    Out_.insert(Out_.end(), bytes, bytes + size);
+  }
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  void Write(const T& value) {
+    Write(&value, sizeof(value));
+  }
+
+  template <class T>
+  void WriteVector(const std::vector<T>& values) {
+    Write<uint32_t>(values.size());
+    Write(values.data(), values.size() * sizeof(T));
+  }
+
+ private:
+  std::vector<uint8_t>& Out_;
+};
+
+// Reads back what SimStateWriter wrote. Running off the end means the snapshot does not belong to
+// this peripheral, which is a programming error: it is logged on behalf of avr and aborts.
+class SimStateReader {
+ public:
+  SimStateReader(std::span<const uint8_t> in, avr_t* avr) : In_(in), Avr_(avr) {}
+
+  void Read(void* data, size_t size);
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  void Read(T& value) {
+    Read(&value, sizeof(value));
+  }
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  T Read() {
+    T value;
+    Read(value);
+    return value;
+  }
+
+  template <class T>
+  void ReadVector(std::vector<T>& values) {
+    values.resize(Read<uint32_t>());
+    Read(values.data(), values.size() * sizeof(T));
+  }
+
+  bool AtEnd() const { return Position_ == In_.size(); }
+
+ private:
+  std::span<const uint8_t> In_;
+  avr_t* Avr_{nullptr};
+  size_t Position_{0};
+};
+
+// A peripheral whose state can be captured and put back, including the cycle timers it has
+// pending. RestoreState() may be called on a peripheral that has moved on since the save, or on an
+// identically built one attached to another AVR whose core has been restored to the same cycle.
+class SimStateful {
+ public:
+  virtual ~SimStateful() = default;
+  virtual void SaveState(SimStateWriter& out) const = 0;
+  virtual void RestoreState(SimStateReader& in) = 0;
+};
+
+// Save and restore when a timer is next due. Restoring reschedules or cancels it; the callback
+// bound to it stays as it is.
+void SimSaveTimer(SimStateWriter& out, const SimTimer& timer);
+void SimRestoreTimer(SimStateReader& in, SimTimer& timer);
+
+// Save and restore the level last raised on an IRQ, without notifying anyone: the other end's view
+// of it is part of the state being restored too.
+void SimSaveIrqValue(SimStateWriter& out, const avr_irq_t* irq);
+void SimRestoreIrqValue(SimStateReader& in, avr_irq_t* irq);
@@ -1,19 +1,16 @@
 #pragma once
 
-#include <array>
 #include <cstdint>
-#include <functional>
 #include <map>
+#include <simavr-toolbox/sim_i2c_register_map.hpp>
+#include <simavr-toolbox/timer.hpp>
 
-#include "sim_i2c_base.hpp"
 #include "sim_irq.h"
 
-class SimTca8418 : public SimAvrI2CComponent {
+class SimTca8418 : public SimAvrI2CRegisterComponent<SimTca8418> {
  public:
   static constexpr uint8_t I2C_ADDRESS = 0x68;
   SimTca8418(avr_t* avr, avr_irq_t* intIrq);
-  virtual void HandleI2CMessage(const avr_twi_msg_t& msg) override;
-  virtual void ResetStateMachine() override;
   enum class Event { Release = 0x00, Press = 0x80 };
   void AddKeyEvent(Event ev, uint8_t row, uint8_t col);
   void AddKeyEventCode(Event ev, uint8_t row, uint8_t col);
@@ -21,6 +18,10 @@ class SimTca8418 : public SimAvrI2CComponent {
   void AddKeyPress(uint8_t rawKeyCode);
   void AddKeyRelease(uint8_t rawKeyCode);
 
+  // Registers, the key FIFO and the releases still to come from AddKeyPressAndRelease().
+  void SaveState(SimStateWriter& out) const override;
+  void RestoreState(SimStateReader& in) override;
+
  private:
   enum register_t : uint8_t {
     CFG = 0x01,
@@ -47,26 +48,30 @@ class SimTca8418 : public SimAvrI2CComponent {
     GPIO_PULL2 = 0x2D,
     GPIO_PULL3 = 0x2E,
   };
-  void AddKeyRawEventAndClearPending(uint8_t rawKeyCode);
+  void ScheduleRelease(uint8_t keyCode, avr_cycle_count_t when);
   void AddKeyRawEvent(uint8_t rawKeyCode);
-  void CheckSpecialCaseWrite(register_t reg, uint8_t oldData, uint8_t newData);
-  void CheckSpecialCaseReads(register_t reg);
+  void OnIntStatWrite(uint8_t oldData, uint8_t newData);
   void OnFifoRead();
   void ModifyRegister(register_t register_address, uint8_t data, uint8_t mask);
-  void IncrementSelectedRegisterMaybe();
-  enum class State {
-    Start,
-    GiveRegisterAddress,
-    MaybeWriteOrReadRegister,
-    ReadRegister,
-    WriteRegister,
-  };
-  State State_{State::Start};
-  uint8_t SelectedRegister_{0};
+
+  friend class SimAvrI2CRegisterComponent<SimTca8418>;
+  static const SimI2CRegisterMap<SimTca8418> kRegisterMap;
+
   uint8_t UnacknowledgedInts_{0};
-  std::array<uint8_t, 0x2F> Registers_;
   avr_t* Avr_{nullptr};
   avr_irq_t* AvrIntIrq_{nullptr};
-  using Cb = std::function<void()>;
-  std::map<uint8_t /* key code */, Cb> PendingPresses_;
-};
\ No newline at end of file
+  // One release timer per key code, kept once created so that later presses do not allocate.
+  std::map<uint8_t /* key code */, SimTimer> PendingReleases_;
+};
+
+// "The default value in all registers is 0". Auto-increment is bit 7 of CFG, and runs up to 0x2E;
+// 0x2F is reserved, and it wraps around to 0, even though 0 is reserved. Writes take effect byte by
+// byte, as clearing INT_STAT releases the INT line while the AVR is still on the bus.
+inline constexpr SimI2CRegisterMap<SimTca8418> SimTca8418::kRegisterMap =
+    MakeSimI2CRegisterMap<SimTca8418>(
+        {.Count = 0x2F, .AutoIncrementRegister = CFG, .AutoIncrementRegisterBits = 0x80,
+         .WrapAfter = 0x2E, .WriteEachByte = true},
+        {
+            {.Address = INT_STAT, .OnWrite = &SimTca8418::OnIntStatWrite},
+            {.Address = KEY_EVENT_A, .OnRead = &SimTca8418::OnFifoRead},
+        });
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "sim_tick_service.hpp"
+
+#include <simavr/sim_time.h>
+
+#include <algorithm>
+#include <simavr-toolbox/sim_avr_registry.hpp>
+
+std::shared_ptr<SimTickService> SimTickService::Get(avr_t* avr) {
+  return GetPerAvrInstance<SimTickService>(avr);
+}
+
+SimTickService::SimTickService(avr_t* avr) : Avr_(avr) {}
+
+void SimTickService::Subscribe(std::chrono::microseconds period, TickFn fn, void* param) {
+  Ticker& ticker = GetTicker(period);
+  auto it = std::ranges::find(ticker.Subscribers, param, &Subscriber::Param);
+  if (it == ticker.Subscribers.end() || !it->Fn) {
+    ticker.Subscribers.push_back({fn, param});
+  }
+
+  // Also pulls the timer back onto the current period after a board restore has wound the clock
+  // back past it. A timer that is running its subscribers re-arms itself.
+  if (ticker.Dispatching) {
+    return;
+  }
+  avr_cycle_count_t next = (Avr_->cycle / ticker.PeriodCycles + 1) * ticker.PeriodCycles;
+  avr_cycle_count_t status = ticker.Timer.Status();
+  if (status == 0 || Avr_->cycle + status - 1 > next) {
+    ticker.Timer.ScheduleAt(next);
+  }
+}
+
+void SimTickService::Unsubscribe(std::chrono::microseconds period, void* param) {
+  auto found = std::ranges::find(Tickers_, period, &Ticker::Period);
+  if (found == Tickers_.end()) {
+    return;
+  }
+  Ticker& ticker = **found;
+  auto it = std::ranges::find(ticker.Subscribers, param, &Subscriber::Param);
+  if (it == ticker.Subscribers.end()) {
+    return;
+  }
+  if (ticker.Dispatching) {
+    // Dispatch() compacts the array once every subscriber has had its tick.
+    it->Fn = nullptr;
+    return;
+  }
+  ticker.Subscribers.erase(it);
+  if (ticker.Subscribers.empty()) {
+    ticker.Timer.Cancel();
+  }
+}
+
+bool SimTickService::IsSubscribed(std::chrono::microseconds period, const void* param) const {
+  const Ticker* ticker = FindTicker(period);
+  if (!ticker) {
+    return false;
+  }
+  return std::ranges::any_of(ticker->Subscribers, [param](const Subscriber& subscriber) {
+    return subscriber.Param == param && subscriber.Fn;
+  });
+}
+
+SimTickService::Ticker& SimTickService::GetTicker(std::chrono::microseconds period) {
+  auto found = std::ranges::find(Tickers_, period, &Ticker::Period);
+  if (found != Tickers_.end()) {
+    return **found;
+  }
+
+  auto ticker = std::make_unique<Ticker>();
+  ticker->Period = period;
+  ticker->PeriodCycles = std::max<avr_cycle_count_t>(1, avr_usec_to_cycles(Avr_, period.count()));
+  ticker->Timer.Bind(Avr_, [this, t = ticker.get()](avr_cycle_count_t when) {
+    return Dispatch(*t, when);
+  });
+  Tickers_.push_back(std::move(ticker));
+  return *Tickers_.back();
+}
+
+const SimTickService::Ticker* SimTickService::FindTicker(std::chrono::microseconds period) const {
+  auto found = std::ranges::find(Tickers_, period, &Ticker::Period);
+  return found == Tickers_.end() ? nullptr : found->get();
+}
+
+avr_cycle_count_t SimTickService::Dispatch(Ticker& ticker, avr_cycle_count_t when) {
+  ticker.Dispatching = true;
+  // Subscribers that join during the tick get their first one next time.
+  const size_t count = ticker.Subscribers.size();
+  for (size_t i = 0; i < count; ++i) {
+    Subscriber subscriber = ticker.Subscribers[i];
+    if (subscriber.Fn && !subscriber.Fn(subscriber.Param, when)) {
+      ticker.Subscribers[i].Fn = nullptr;
+    }
+  }
+  ticker.Dispatching = false;
+  std::erase_if(ticker.Subscribers, [](const Subscriber& subscriber) { return !subscriber.Fn; });
+
+  return ticker.Subscribers.empty() ? 0 : when + ticker.PeriodCycles;
+}
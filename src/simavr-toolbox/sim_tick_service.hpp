@@ -0,0 +1,57 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <simavr-toolbox/timer.hpp>
+#include <vector>
+
+// Periodic ticks shared by the peripherals on one AVR. Each period in use runs a single timer
+// that calls every subscriber in turn, and stops when the last subscriber goes away; peripherals
+// subscribe only while they have something to count down. Ticks fall on multiples of the period
+// counted from cycle 0, so they land on the same cycles whenever a subscriber joins and across a
+// board restore.
+class SimTickService {
+ public:
+  // Called on every tick with the cycle it fell on. Returning false unsubscribes.
+  using TickFn = bool (*)(void* param, avr_cycle_count_t when);
+
+  static constexpr std::chrono::microseconds kMillisecond{1000};
+  static constexpr std::chrono::microseconds kSecond{1000000};
+
+  // The service for `avr`, created on first use. See GetPerAvrInstance().
+  static std::shared_ptr<SimTickService> Get(avr_t* avr);
+
+  explicit SimTickService(avr_t* avr);
+  SimTickService(const SimTickService&) = delete;
+  SimTickService& operator=(const SimTickService&) = delete;
+
+  // Subscribing again with the same period and param is a no-op.
+  void Subscribe(std::chrono::microseconds period, TickFn fn, void* param);
+  void Unsubscribe(std::chrono::microseconds period, void* param);
+  bool IsSubscribed(std::chrono::microseconds period, const void* param) const;
+
+ private:
+  struct Subscriber {
+    TickFn Fn;
+    void* Param;
+  };
+
+  struct Ticker {
+    std::chrono::microseconds Period;
+    avr_cycle_count_t PeriodCycles;
+    std::vector<Subscriber> Subscribers;
+    bool Dispatching{false};
+    SimTimer Timer;
+  };
+
+  Ticker& GetTicker(std::chrono::microseconds period);
+  const Ticker* FindTicker(std::chrono::microseconds period) const;
+  avr_cycle_count_t Dispatch(Ticker& ticker, avr_cycle_count_t when);
+
+  avr_t* Avr_;
+  // A handful of periods at most; tickers never move once created.
+  std::vector<std::unique_ptr<Ticker>> Tickers_;
+};
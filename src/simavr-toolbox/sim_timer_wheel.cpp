@@ -0,0 +1,226 @@
+#include "sim_timer_wheel.hpp"
+
+#include <simavr/sim_time.h>
+
+#include <algorithm>
+#include <bit>
+#include <simavr-toolbox/sim_avr_registry.hpp>
+
+std::shared_ptr<SimTimerWheel> SimTimerWheel::Get(avr_t* avr) {
+  return GetPerAvrInstance<SimTimerWheel>(avr);
+}
+
+SimTimerWheel::SimTimerWheel(avr_t* avr) : Avr_(avr), Now_(avr->cycle) {
+  for (auto& bucket : Buckets_) {
+    bucket.Prev = bucket.Next = &bucket;
+  }
+}
+
+SimTimerWheel::~SimTimerWheel() {
+  avr_cycle_timer_cancel(Avr_, OnTimer, this);
+  for (uint16_t bucket = 0; bucket < kBuckets; ++bucket) {
+    while (!IsEmpty(bucket)) {
+      Unlink(First(bucket));
+    }
+  }
+}
+
+void SimTimerWheel::ScheduleAt(Event& event, avr_cycle_count_t when, avr_cycle_timer_t fn,
+                               void* param) {
+  Sync();
+  if (event.IsPending()) {
+    Unlink(event);
+  }
+  if (Pending_ == 0) {
+    // Nothing to cascade: skip the clock ahead so the event lands on a low level.
+    Now_ = std::max(Now_, Avr_->cycle);
+  }
+  event.Wheel_ = this;
+  event.Fn_ = fn;
+  event.Param_ = param;
+  event.When_ = when;
+  Arm(File(event));
+}
+
+void SimTimerWheel::ScheduleIn(Event& event, avr_cycle_count_t cycles, avr_cycle_timer_t fn,
+                               void* param) {
+  ScheduleAt(event, Avr_->cycle + cycles, fn, param);
+}
+
+void SimTimerWheel::ScheduleInUsec(Event& event, uint32_t usec, avr_cycle_timer_t fn,
+                                   void* param) {
+  ScheduleIn(event, avr_usec_to_cycles(Avr_, usec), fn, param);
+}
+
+void SimTimerWheel::Cancel(Event& event) {
+  // The simavr timer stays armed; waking up to nothing is cheaper than working out the new
+  // earliest deadline here.
+  if (event.IsPending()) {
+    Unlink(event);
+  }
+}
+
+avr_cycle_count_t SimTimerWheel::Status(const Event& event) const {
+  if (!event.IsPending()) {
+    return 0;
+  }
+  return event.When_ > Avr_->cycle ? event.When_ - Avr_->cycle + 1 : 1;
+}
+
+void SimTimerWheel::Rebase() {
+  for (uint16_t bucket = 0; bucket < kReady; ++bucket) {
+    MoveAll(bucket, kFiring);
+  }
+  MoveAll(kReady, kFiring);
+  Now_ = Avr_->cycle;
+  while (!IsEmpty(kFiring)) {
+    Event& event = First(kFiring);
+    Unlink(event);
+    File(event);
+  }
+
+  if (InTimer_) {
+    return;
+  }
+  avr_cycle_timer_cancel(Avr_, OnTimer, this);
+  Armed_ = false;
+  avr_cycle_count_t wakeup;
+  if (NextWakeup(wakeup)) {
+    Arm(wakeup);
+  }
+}
+
+avr_cycle_count_t SimTimerWheel::OnTimer(avr_t* avr, avr_cycle_count_t when, void* param) {
+  auto* wheel = static_cast<SimTimerWheel*>(param);
+  wheel->Armed_ = false;
+  wheel->InTimer_ = true;
+  wheel->Sync();
+
+  const avr_cycle_count_t until = std::max(when, avr->cycle);
+  avr_cycle_count_t next;
+  while (wheel->NextWakeup(next) && next <= until) {
+    wheel->Now_ = next;
+    wheel->Step();
+  }
+  wheel->InTimer_ = false;
+
+  if (!wheel->NextWakeup(next)) {
+    return 0;
+  }
+  wheel->Armed_ = true;
+  wheel->ArmedAt_ = next;
+  return next;
+}
+
+void SimTimerWheel::Link(Event& event, uint16_t bucket) {
+  ListNode& head = Buckets_[bucket];
+  event.Prev = head.Prev;
+  event.Next = &head;
+  head.Prev->Next = &event;
+  head.Prev = &event;
+  event.Bucket_ = bucket;
+  if (bucket < kReady) {
+    Occupied_[bucket / kSlots] |= uint64_t{1} << (bucket % kSlots);
+  }
+  ++Pending_;
+}
+
+void SimTimerWheel::Unlink(Event& event) {
+  event.Prev->Next = event.Next;
+  event.Next->Prev = event.Prev;
+  event.Prev = event.Next = nullptr;
+  uint16_t bucket = event.Bucket_;
+  event.Bucket_ = Event::kNoBucket;
+  if (bucket < kReady && IsEmpty(bucket)) {
+    Occupied_[bucket / kSlots] &= ~(uint64_t{1} << (bucket % kSlots));
+  }
+  --Pending_;
+}
+
+avr_cycle_count_t SimTimerWheel::File(Event& event) {
+  const avr_cycle_count_t when = event.When_;
+  if (when <= Now_) {
+    Link(event, kReady);
+    return Now_;
+  }
+  // The highest bit in which the deadline differs from the clock picks the level; the deadline's
+  // bits at that level pick the slot.
+  unsigned level = (63 - std::countl_zero(when ^ Now_)) / kSlotBits;
+  unsigned shift = level * kSlotBits;
+  unsigned slot = (when >> shift) & (kSlots - 1);
+  Link(event, level * kSlots + slot);
+  return (when >> shift) << shift;
+}
+
+void SimTimerWheel::MoveAll(uint16_t from, uint16_t to) {
+  while (!IsEmpty(from)) {
+    Event& event = First(from);
+    Unlink(event);
+    Link(event, to);
+  }
+}
+
+bool SimTimerWheel::NextWakeup(avr_cycle_count_t& when) const {
+  if (!IsEmpty(kReady)) {
+    when = Now_;
+    return true;
+  }
+  // Everything on a level is due before anything on the level above.
+  for (unsigned level = 0; level < kLevels; ++level) {
+    unsigned shift = level * kSlotBits;
+    unsigned current = (Now_ >> shift) & (kSlots - 1);
+    uint64_t ahead = Occupied_[level] & (~uint64_t{0} << current);
+    if (!ahead) {
+      continue;
+    }
+    unsigned above = shift + kSlotBits;
+    avr_cycle_count_t block = above < 64 ? (Now_ >> above) << above : 0;
+    when = block | (static_cast<avr_cycle_count_t>(std::countr_zero(ahead)) << shift);
+    return true;
+  }
+  return false;
+}
+
+void SimTimerWheel::Step() {
+  // Bring down everything whose slot the clock has reached, top level first so that events pass
+  // through the levels in between.
+  for (unsigned level = kLevels - 1; level > 0; --level) {
+    unsigned shift = level * kSlotBits;
+    uint16_t bucket = level * kSlots + ((Now_ >> shift) & (kSlots - 1));
+    while (!IsEmpty(bucket)) {
+      Event& event = First(bucket);
+      Unlink(event);
+      File(event);
+    }
+  }
+  MoveAll(Now_ & (kSlots - 1), kFiring);
+  MoveAll(kReady, kFiring);
+
+  // Callbacks may schedule and cancel anything, including events still waiting to fire here.
+  while (!IsEmpty(kFiring)) {
+    Event& event = First(kFiring);
+    Unlink(event);
+    avr_cycle_count_t next = event.Fn_(Avr_, event.When_, event.Param_);
+    if (next && !event.IsPending()) {
+      // A callback asking to run again right away runs on the next cycle rather than looping.
+      event.When_ = std::max(next, Now_ + 1);
+      File(event);
+    }
+  }
+}
+
+void SimTimerWheel::Sync() {
+  if (Avr_->cycle < Now_) {
+    Rebase();
+  }
+}
+
+void SimTimerWheel::Arm(avr_cycle_count_t wakeup) {
+  // OnTimer() re-arms for whatever is earliest once its callbacks are done.
+  if (InTimer_ || (Armed_ && ArmedAt_ <= wakeup)) {
+    return;
+  }
+  avr_cycle_timer_register(Avr_, wakeup > Avr_->cycle ? wakeup - Avr_->cycle : 0, OnTimer, this);
+  Armed_ = true;
+  ArmedAt_ = wakeup;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_cycle_timers.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// A hierarchical timer wheel shared by the toolbox peripherals on one AVR. Any number of events
+// can be pending while the wheel keeps a single simavr cycle timer registered, for the earliest
+// point at which something has to happen. Scheduling and cancelling an event are O(1), and the
+// events live in the peripherals that own them, so the wheel never allocates.
+//
+// The wheel has 11 levels of 64 slots. Level 0 holds events due in the current block of 64 cycles,
+// one slot per cycle; level n holds events whose deadline first differs from the wheel's clock in
+// bits 6n to 6n+5. When the clock reaches a slot on an upper level, its events move down.
+//
+// Callbacks have the same signature and return value as simavr cycle timers: the absolute cycle to
+// run again at, or 0. Restoring a board to an earlier cycle is noticed on the next call and the
+// pending events are re-filed against the restored clock; their owners are expected to reschedule
+// or cancel them as part of their own restore.
+class SimTimerWheel {
+  struct ListNode {
+    ListNode* Prev{nullptr};
+    ListNode* Next{nullptr};
+  };
+
+ public:
+  // A pending callback. Owned by the peripheral and never copied; cancelled when destroyed.
+  class Event : private ListNode {
+   public:
+    Event() = default;
+    ~Event() { Cancel(); }
+    Event(const Event&) = delete;
+    Event& operator=(const Event&) = delete;
+
+    bool IsPending() const { return Bucket_ != kNoBucket; }
+    // The absolute cycle the event is due at, while it is pending.
+    avr_cycle_count_t When() const { return When_; }
+    void Cancel() {
+      if (IsPending()) {
+        Wheel_->Cancel(*this);
+      }
+    }
+
+   private:
+    friend class SimTimerWheel;
+    static constexpr uint16_t kNoBucket = 0xFFFF;
+
+    SimTimerWheel* Wheel_{nullptr};
+    avr_cycle_timer_t Fn_{nullptr};
+    void* Param_{nullptr};
+    avr_cycle_count_t When_{0};
+    uint16_t Bucket_{kNoBucket};
+  };
+
+  // The wheel for `avr`, created on first use. See GetPerAvrInstance().
+  static std::shared_ptr<SimTimerWheel> Get(avr_t* avr);
+
+  explicit SimTimerWheel(avr_t* avr);
+  ~SimTimerWheel();
+  SimTimerWheel(const SimTimerWheel&) = delete;
+  SimTimerWheel& operator=(const SimTimerWheel&) = delete;
+
+  avr_t* Avr() const { return Avr_; }
+
+  // Run fn(avr, when, param) at absolute cycle `when`, or `cycles`/`usec` from now. Rescheduling a
+  // pending event moves it.
+  void ScheduleAt(Event& event, avr_cycle_count_t when, avr_cycle_timer_t fn, void* param);
+  void ScheduleIn(Event& event, avr_cycle_count_t cycles, avr_cycle_timer_t fn, void* param);
+  void ScheduleInUsec(Event& event, uint32_t usec, avr_cycle_timer_t fn, void* param);
+  void Cancel(Event& event);
+
+  // Like avr_cycle_timer_status(): one more than the cycles until the event is due, 0 when it is
+  // not pending.
+  avr_cycle_count_t Status(const Event& event) const;
+
+  // Re-file every pending event against the AVR's current cycle and re-arm the simavr timer. Called
+  // automatically when the cycle counter is seen to have gone backwards; SimBoardState calls it
+  // after putting back the simavr timer list.
+  void Rebase();
+
+ private:
+  static constexpr unsigned kSlotBits = 6;
+  static constexpr unsigned kSlots = 1 << kSlotBits;
+  static constexpr unsigned kLevels = (64 + kSlotBits - 1) / kSlotBits;
+  // Events already due, and events taken out of their slot to be run.
+  static constexpr uint16_t kReady = kLevels * kSlots;
+  static constexpr uint16_t kFiring = kReady + 1;
+  static constexpr uint16_t kBuckets = kFiring + 1;
+
+  static avr_cycle_count_t OnTimer(avr_t* avr, avr_cycle_count_t when, void* param);
+
+  bool IsEmpty(uint16_t bucket) const { return Buckets_[bucket].Next == &Buckets_[bucket]; }
+  Event& First(uint16_t bucket) { return static_cast<Event&>(*Buckets_[bucket].Next); }
+  void Link(Event& event, uint16_t bucket);
+  void Unlink(Event& event);
+  // Puts a pending event in the bucket for its deadline and returns the cycle the wheel has to
+  // wake up at for it.
+  avr_cycle_count_t File(Event& event);
+  void MoveAll(uint16_t from, uint16_t to);
+  bool NextWakeup(avr_cycle_count_t& when) const;
+  void Step();
+  void Sync();
+  void Arm(avr_cycle_count_t wakeup);
+
+  avr_t* Avr_;
+  // Every event due before this cycle has run.
+  avr_cycle_count_t Now_;
+  std::array<uint64_t, kLevels> Occupied_{};
+  // Circular lists; an empty bucket points at itself.
+  std::array<ListNode, kBuckets> Buckets_;
+  size_t Pending_{0};
+  bool Armed_{false};
+  avr_cycle_count_t ArmedAt_{0};
+  bool InTimer_{false};
+};
@@ -4,57 +4,21 @@
 #include <cstdint>
 #include <cstdlib>
 
-#include "avr_twi.h"
 #include "sim_base.hpp"
-#include "sim_i2c_base.hpp"
 
-SimTLC59116::SimTLC59116(avr_t* avr, uint8_t i2cAddress) : SimAvrI2CComponent(avr, i2cAddress) {
-  Registers_.fill(0);
+SimTLC59116::SimTLC59116(avr_t* avr, uint8_t i2cAddress)
+    : SimAvrI2CRegisterComponent(avr, i2cAddress),
+      StatePublisher_(avr, [this] { StateSnapshot_.Publish(GetCurrentState()); }) {
+  StatePublisher_.Flush();
 }
 
-void SimTLC59116::HandleI2CMessage(const avr_twi_msg_t& message) {
-  if (message.msg & TWI_COND_START) {
-    if (State_ == State::Start) {
-      auto mode_ = static_cast<I2CMode>(message.addr & 1);
-      if (mode_ == I2CMode::WRITE) {
-        State_ = State::GiveRegisterAddress;
-      } else {
-        std::abort();
-      }
-    } else {
-      std::abort();
-    }
-    SendToAvrI2CAck();
-  } else if (message.msg & TWI_COND_STOP) {
-    ResetStateMachine();
-  } else if (message.msg & TWI_COND_WRITE) {
-    SendToAvrI2CAck();
-    if (State_ == State::GiveRegisterAddress) {
-      AutoIncrement_ = (message.data & 0xE0) != 0;  // TODO support other AI modes
-      SelectedRegister_ = message.data & 0x1F;
-      State_ = State::WriteRegister;
-    } else if (State_ == State::WriteRegister) {
-      // They decided to write a register, do it
-      Registers_.at(SelectedRegister_) = message.data;
-      if (AutoIncrement_) {
-        SelectedRegister_ += 1;
-        // TODO support other AI modes
-        if (SelectedRegister_ > 0x1B) {
-          SelectedRegister_ = 0;
-        }
-      }
-      // sim_debug_log("Wrote Register %02x = %02X\n", SelectedRegister_, message.data);
-    }
-  } else if (message.msg & TWI_COND_READ) {
-    std::abort();
-  }
+void SimTLC59116::OnLedRegisterWrite(uint8_t oldValue, uint8_t newValue) {
+  StatePublisher_.MarkDirty();
 }
 
-void SimTLC59116::ResetStateMachine() {
-  CommandBuffer_.clear();
-  State_ = State::Start;
-  AutoIncrement_ = false;
-  SelectedRegister_ = 0;
+void SimTLC59116::RestoreState(SimStateReader& in) {
+  SimAvrI2CRegisterComponent::RestoreState(in);
+  StatePublisher_.Flush();
 }
 
 enum class LedState : uint8_t {
@@ -64,13 +28,17 @@ enum class LedState : uint8_t {
   PwmGroup = 3,
 };
 
+SimSnapshot<std::array<uint8_t, 16>>& SimTLC59116::GetStateSnapshot() {
+  return StateSnapshot_;
+}
+
 std::array<uint8_t, 16> SimTLC59116::GetCurrentState() const {
   std::array<uint8_t, 16> value;
 
   for (int i = 0; i < 16; ++i) {
     const uint8_t reg = i / 4;
     const uint8_t bit = i % 4;
-    auto reg_2 = (Registers_.at(0x14 + reg) >> (2 * bit)) & 0x03;
+    auto reg_2 = (Registers_[LEDOUT0 + reg] >> (2 * bit)) & 0x03;
     const auto status = static_cast<LedState>(reg_2);
     switch (status) {
       case LedState::Off:
@@ -80,7 +48,7 @@ std::array<uint8_t, 16> SimTLC59116::GetCurrentState() const {
         value[i] = 1;
         break;
       case LedState::Pwm:
-        value[i] = Registers_.at(0x02 + i);
+        value[i] = Registers_[PWM0 + i];
         break;
       case LedState::PwmGroup:
         std::abort();
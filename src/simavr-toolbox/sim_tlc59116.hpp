@@ -2,27 +2,41 @@
 
 #include <array>
 #include <cstdint>
-#include <vector>
+#include <simavr-toolbox/sim_i2c_register_map.hpp>
 
 #include "sim_avr.h"
-#include "sim_i2c_base.hpp"
+#include "sim_snapshot.hpp"
 
-class SimTLC59116 final : public SimAvrI2CComponent {
+class SimTLC59116 final : public SimAvrI2CRegisterComponent<SimTLC59116> {
  public:
   SimTLC59116(avr_t* avr, uint8_t i2cAddress);
-  virtual void HandleI2CMessage(const avr_twi_msg_t& msg) override;
-  virtual void ResetStateMachine() override;
   std::array<uint8_t, 16> GetCurrentState() const;
+  // GetCurrentState() for the UI thread, published at most once per frame.
+  SimSnapshot<std::array<uint8_t, 16>>& GetStateSnapshot();
+
+  void RestoreState(SimStateReader& in) override;
 
  private:
-  enum class State {
-    Start,
-    GiveRegisterAddress,
-    ReadRegister,
-    WriteRegister,
-  } State_{State::Start};
-  std::vector<uint8_t> CommandBuffer_;
-  std::array<uint8_t, 0x1E> Registers_;
-  uint8_t SelectedRegister_{0};
-  bool AutoIncrement_{false};
-};
\ No newline at end of file
+  enum : uint8_t {
+    PWM0 = 0x02,
+    LEDOUT0 = 0x14,
+  };
+  void OnLedRegisterWrite(uint8_t oldValue, uint8_t newValue);
+
+  friend class SimAvrI2CRegisterComponent<SimTLC59116>;
+  static const SimI2CRegisterMap<SimTLC59116> kRegisterMap;
+
+  SimSnapshot<std::array<uint8_t, 16>> StateSnapshot_;
+  SimSnapshotPublisher StatePublisher_;
+};
+
+// The control byte written first holds the register address in its low five bits and the
+// auto-increment mode in the top three. TODO support other AI modes: all of them currently run
+// over every register up to 0x1B and wrap to 0.
+inline constexpr SimI2CRegisterMap<SimTLC59116> SimTLC59116::kRegisterMap =
+    MakeSimI2CRegisterMap<SimTLC59116>(
+        {.Count = 0x1E, .AddressMask = 0x1F, .AutoIncrementFlags = 0xE0, .WrapAfter = 0x1B},
+        {
+            {.Address = PWM0, .Span = 16, .OnWrite = &SimTLC59116::OnLedRegisterWrite},
+            {.Address = LEDOUT0, .Span = 4, .OnWrite = &SimTLC59116::OnLedRegisterWrite},
+        });
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "sim_trace_log.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// How each argument is read from the va_list and handed back to snprintf.
+enum ArgKind : uint8_t {
+  kInt,
+  kLong,
+  kLongLong,
+  kIntMax,
+  kSize,
+  kPtrDiff,
+  kDouble,
+  kLongDouble,
+  kString,
+  kPointer,
+  kCount,
+};
+
+struct Conversion {
+  size_t End{0};  // One past the conversion character
+  bool Literal{true};
+  uint8_t Stars{0};
+  int16_t Precision{-1};
+  ArgKind Kind{kInt};
+};
+
+// Parse the conversion specification starting at format[pos], which is a '%'.
+Conversion ParseConversion(std::string_view format, size_t pos) {
+  Conversion c;
+  size_t i = pos + 1;
+  auto digits = [&] {
+    int value = 0;
+    while (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+      value = value * 10 + (format[i++] - '0');
+    }
+    return value;
+  };
+
+  while (i < format.size() && std::strchr("-+ #0'", format[i]) && format[i] != '\0') {
+    ++i;
+  }
+  if (i < format.size() && format[i] == '*') {
+    ++c.Stars;
+    ++i;
+  } else {
+    digits();
+  }
+  if (i < format.size() && format[i] == '.') {
+    ++i;
+    if (i < format.size() && format[i] == '*') {
+      ++c.Stars;
+      c.Precision = -2;
+      ++i;
+    } else {
+      c.Precision = digits();
+    }
+  }
+
+  ArgKind integer = kInt;
+  bool long_double = false;
+  while (i < format.size() && std::strchr("hlLjzt", format[i]) && format[i] != '\0') {
+    switch (format[i]) {
+      case 'l':
+        integer = integer == kLong ? kLongLong : kLong;
+        break;
+      case 'L':
+        long_double = true;
+        break;
+      case 'j':
+        integer = kIntMax;
+        break;
+      case 'z':
+        integer = kSize;
+        break;
+      case 't':
+        integer = kPtrDiff;
+        break;
+    }
+    ++i;
+  }
+
+  if (i >= format.size()) {
+    c.End = format.size();
+    c.Stars = 0;
+    return c;
+  }
+
+  c.End = i + 1;
+  c.Literal = false;
+  switch (format[i]) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      c.Kind = integer;
+      break;
+    case 'c':
+      c.Kind = kInt;
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      c.Kind = long_double ? kLongDouble : kDouble;
+      break;
+    case 's':
+      c.Kind = kString;
+      break;
+    case 'p':
+      c.Kind = kPointer;
+      break;
+    case 'n':
+      c.Kind = kCount;
+      break;
+    default:
+      // "%%", or something we don't understand: print it as it is.
+      c.Literal = true;
+      c.Stars = 0;
+      break;
+  }
+  return c;
+}
+
+template <class... Args>
+void AppendFormatted(std::string& out, const char* spec, Args... args) {
+  char buffer[128];
+  int n = std::snprintf(buffer, sizeof(buffer), spec, args...);
+  if (n < 0) {
+    return;
+  }
+  if (static_cast<size_t>(n) < sizeof(buffer)) {
+    out.append(buffer, n);
+  } else {
+    size_t start = out.size();
+    out.resize(start + n + 1);
+    std::snprintf(&out[start], n + 1, spec, args...);
+    out.resize(start + n);
+  }
+}
+
+template <class T>
+void AppendConversion(std::string& out, const char* spec, const int* stars, uint8_t star_count,
+                      T value) {
+  if (star_count == 0) {
+    AppendFormatted(out, spec, value);
+  } else if (star_count == 1) {
+    AppendFormatted(out, spec, stars[0], value);
+  } else {
+    AppendFormatted(out, spec, stars[0], stars[1], value);
+  }
+}
+
+double ToDouble(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+constexpr char kDumpMagic[8] = {'S', 'I', 'M', 'T', 'R', 'C', '1', '\0'};
+
+}  // namespace
+
+SimTraceLog::SimTraceLog(avr_t* avr, size_t capacity) : Avr_(avr), Entries_(capacity) {}
+
+SimTraceLog::~SimTraceLog() {
+  Uninstall();
+}
+
+void SimTraceLog::Install() {
+  if (Installed_) {
+    return;
+  }
+  Context_ = SimLogContext::Get(Avr_);
+  PreviousSink_ = Context_->GetSink();
+  Context_->SetSink([this](SimLogLevel, const char* fmt, va_list args) { Record(fmt, args); });
+  Installed_ = true;
+}
+
+void SimTraceLog::Uninstall() {
+  if (Installed_) {
+    Context_->SetSink(std::move(PreviousSink_));
+    Context_.reset();
+    Installed_ = false;
+  }
+}
+
+SimTraceLog::Signature SimTraceLog::Parse(const char* fmt) {
+  Signature signature;
+  signature.Format = fmt;
+
+  std::string_view format(fmt);
+  for (size_t pos = format.find('%'); pos != std::string_view::npos;
+       pos = format.find('%', pos)) {
+    auto c = ParseConversion(format, pos);
+    pos = c.End;
+    if (c.Literal) {
+      continue;
+    }
+    for (uint8_t i = 0; i <= c.Stars; ++i) {
+      if (signature.ArgCount == kMaxArgs) {
+        return signature;
+      }
+      bool value = i == c.Stars;
+      signature.Kinds[signature.ArgCount] = value ? c.Kind : kInt;
+      signature.Precision[signature.ArgCount] = value ? c.Precision : -1;
+      signature.ArgCount++;
+    }
+  }
+  return signature;
+}
+
+const SimTraceLog::Signature& SimTraceLog::GetSignature(const char* fmt) {
+  auto& slot = Signatures_[(reinterpret_cast<uintptr_t>(fmt) >> 3) % Signatures_.size()];
+  if (slot.Format != fmt) {
+    slot = Parse(fmt);
+  }
+  return slot;
+}
+
+void SimTraceLog::Record(const char* fmt, va_list args) {
+  if (Entries_.empty()) {
+    return;
+  }
+
+  const auto& signature = GetSignature(fmt);
+
+  Entry& entry = Entries_[Next_];
+  Next_ = (Next_ + 1) % Entries_.size();
+  if (Size_ < Entries_.size()) {
+    Size_++;
+  } else {
+    Dropped_++;
+  }
+
+  entry.Format = fmt;
+  entry.Cycle = Avr_ ? Avr_->cycle : 0;
+  entry.ArgCount = signature.ArgCount;
+  entry.StringBytes = 0;
+
+  int last_int = 0;
+  for (uint8_t i = 0; i < signature.ArgCount; ++i) {
+    uint64_t& arg = entry.Args[i];
+    switch (signature.Kinds[i]) {
+      case kInt:
+        last_int = va_arg(args, int);
+        arg = static_cast<int64_t>(last_int);
+        break;
+      case kLong:
+        arg = static_cast<int64_t>(va_arg(args, long));
+        break;
+      case kLongLong:
+        arg = static_cast<int64_t>(va_arg(args, long long));
+        break;
+      case kIntMax:
+        arg = static_cast<int64_t>(va_arg(args, intmax_t));
+        break;
+      case kSize:
+        arg = va_arg(args, size_t);
+        break;
+      case kPtrDiff:
+        arg = static_cast<int64_t>(va_arg(args, ptrdiff_t));
+        break;
+      case kDouble: {
+        double value = va_arg(args, double);
+        std::memcpy(&arg, &value, sizeof(value));
+        break;
+      }
+      case kLongDouble: {
+        double value = static_cast<double>(va_arg(args, long double));
+        std::memcpy(&arg, &value, sizeof(value));
+        break;
+      }
+      case kString: {
+        const char* s = va_arg(args, const char*);
+        if (!s) {
+          s = "(null)";
+        }
+        // The strings area always ends in a terminator, which an argument that no longer fits
+        // points at.
+        size_t space = kStringBytes - entry.StringBytes;
+        if (space == 0) {
+          arg = kStringBytes - 1;
+          break;
+        }
+        size_t bound = space - 1;
+        int16_t precision = signature.Precision[i];
+        if (precision == -2 && last_int >= 0) {
+          bound = std::min<size_t>(bound, last_int);
+        } else if (precision >= 0) {
+          bound = std::min<size_t>(bound, precision);
+        }
+        size_t length = strnlen(s, bound);
+        std::memcpy(&entry.Strings[entry.StringBytes], s, length);
+        entry.Strings[entry.StringBytes + length] = '\0';
+        arg = entry.StringBytes;
+        entry.StringBytes += length + 1;
+        break;
+      }
+      case kPointer:
+      case kCount:
+        arg = reinterpret_cast<uintptr_t>(va_arg(args, void*));
+        break;
+    }
+  }
+}
+
+size_t SimTraceLog::Size() const {
+  return Size_;
+}
+
+uint64_t SimTraceLog::Dropped() const {
+  return Dropped_;
+}
+
+void SimTraceLog::Clear() {
+  Next_ = 0;
+  Size_ = 0;
+}
+
+std::string SimTraceLog::Format(std::string_view format, const uint64_t* args, size_t arg_count,
+                                const char* strings) {
+  std::string out;
+  std::string spec;
+  size_t arg = 0;
+  size_t pos = 0;
+  while (pos < format.size()) {
+    size_t percent = format.find('%', pos);
+    if (percent == std::string_view::npos) {
+      out.append(format.substr(pos));
+      break;
+    }
+    out.append(format.substr(pos, percent - pos));
+
+    auto c = ParseConversion(format, percent);
+    spec.assign(format.substr(percent, c.End - percent));
+    pos = c.End;
+    if (c.Literal || arg + c.Stars >= arg_count) {
+      // Literal text, or arguments that did not fit in the entry.
+      out.append(spec == "%%" ? "%" : spec);
+      arg += c.Literal ? 0 : c.Stars + 1;
+      continue;
+    }
+
+    int stars[2] = {0, 0};
+    for (uint8_t i = 0; i < c.Stars; ++i) {
+      stars[i] = static_cast<int>(args[arg++]);
+    }
+    uint64_t value = args[arg++];
+    switch (c.Kind) {
+      case kInt:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<int>(value));
+        break;
+      case kLong:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<long>(value));
+        break;
+      case kLongLong:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<long long>(value));
+        break;
+      case kIntMax:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<intmax_t>(value));
+        break;
+      case kSize:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<size_t>(value));
+        break;
+      case kPtrDiff:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, static_cast<ptrdiff_t>(value));
+        break;
+      case kDouble:
+        AppendConversion(out, spec.c_str(), stars, c.Stars, ToDouble(value));
+        break;
+      case kLongDouble:
+        AppendConversion(out, spec.c_str(), stars, c.Stars,
+                         static_cast<long double>(ToDouble(value)));
+        break;
+      case kString:
+        // Offsets past the strings area only come from a damaged dump.
+        AppendConversion(out, spec.c_str(), stars, c.Stars,
+                         value < kStringBytes ? strings + value : "");
+        break;
+      case kPointer:
+        AppendConversion(out, spec.c_str(), stars, c.Stars,
+                         reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+        break;
+      case kCount:
+        // Nothing is printed, and there is nowhere to write the count to.
+        break;
+    }
+  }
+  return out;
+}
+
+void SimTraceLog::ForEach(const EntryCallbackFn& fn) const {
+  size_t first = (Next_ + Entries_.size() - Size_) % std::max<size_t>(Entries_.size(), 1);
+  for (size_t i = 0; i < Size_; ++i) {
+    const Entry& entry = Entries_[(first + i) % Entries_.size()];
+    fn(entry.Cycle,
+       Format(entry.Format, entry.Args.data(), entry.ArgCount, entry.Strings.data()));
+  }
+}
+
+// Dump file layout, in native byte order:
+//   magic "SIMTRC1\0"
+//   uint32 format count, then per format: uint32 length, bytes
+//   uint64 entry count, then per entry: uint32 format index, uint64 cycle, uint8 argument count,
+//     uint8 string bytes, uint64 arguments[argument count], char strings[string bytes]
+bool SimTraceLog::Dump(const char* path) const {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    return false;
+  }
+
+  auto put = [&](const auto& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+
+  size_t first = (Next_ + Entries_.size() - Size_) % std::max<size_t>(Entries_.size(), 1);
+  std::unordered_map<const char*, uint32_t> format_index;
+  std::vector<const char*> formats;
+  for (size_t i = 0; i < Size_; ++i) {
+    const char* format = Entries_[(first + i) % Entries_.size()].Format;
+    if (format_index.emplace(format, formats.size()).second) {
+      formats.push_back(format);
+    }
+  }
+
+  out.write(kDumpMagic, sizeof(kDumpMagic));
+  put(static_cast<uint32_t>(formats.size()));
+  for (const char* format : formats) {
+    uint32_t length = std::strlen(format);
+    put(length);
+    out.write(format, length);
+  }
+
+  put(static_cast<uint64_t>(Size_));
+  for (size_t i = 0; i < Size_; ++i) {
+    const Entry& entry = Entries_[(first + i) % Entries_.size()];
+    put(format_index[entry.Format]);
+    put(static_cast<uint64_t>(entry.Cycle));
+    put(entry.ArgCount);
+    put(entry.StringBytes);
+    out.write(reinterpret_cast<const char*>(entry.Args.data()), entry.ArgCount * sizeof(uint64_t));
+    out.write(entry.Strings.data(), entry.StringBytes);
+  }
+
+  return static_cast<bool>(out);
+}
+
+bool SimTraceLog::Decode(const char* path, const EntryCallbackFn& fn) {
+  std::ifstream in(path, std::ios::binary);
+  auto get = [&](auto& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return static_cast<bool>(in);
+  };
+
+  char magic[sizeof(kDumpMagic)];
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kDumpMagic, sizeof(magic)) != 0) {
+    return false;
+  }
+
+  uint32_t format_count;
+  if (!get(format_count)) {
+    return false;
+  }
+  std::vector<std::string> formats(format_count);
+  for (auto& format : formats) {
+    uint32_t length;
+    if (!get(length)) {
+      return false;
+    }
+    format.resize(length);
+    if (!in.read(format.data(), length)) {
+      return false;
+    }
+  }
+
+  uint64_t entry_count;
+  if (!get(entry_count)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < entry_count; ++i) {
+    uint32_t format;
+    uint64_t cycle;
+    uint8_t arg_count, string_bytes;
+    std::array<uint64_t, kMaxArgs> args;
+    std::array<char, kStringBytes + 1> strings{};
+    if (!get(format) || !get(cycle) || !get(arg_count) || !get(string_bytes) ||
+        format >= formats.size() || arg_count > kMaxArgs || string_bytes > kStringBytes) {
+      return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(args.data()), arg_count * sizeof(uint64_t)) ||
+        !in.read(strings.data(), string_bytes)) {
+      return false;
+    }
+    fn(cycle, Format(formats[format], args.data(), arg_count, strings.data()));
+  }
+  return true;
+}
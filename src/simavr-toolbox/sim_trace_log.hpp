@@ -0,0 +1,94 @@
+#pragma once
+
+#include <simavr/sim_avr.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <simavr-toolbox/sim_base.hpp>
+#include <simavr-toolbox/sim_log_context.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A binary sink for one board's log. Each message is recorded as its format string pointer, the AVR
+// cycle and the raw argument values in a preallocated ring, so logging from the simulation thread
+// does no formatting and no allocation. Text is only produced when entries are read back with
+// ForEach(), or offline by sim-trace-decode from a file written by Dump().
+//
+// Format strings must outlive the log, which holds for the string literals sim_debug_log is called
+// with. String arguments are copied, truncated to what fits in the entry.
+//
+// The log is not synchronised: read it from the simulation thread, or while the simulation is
+// paused.
+class SimTraceLog {
+ public:
+  static constexpr size_t kMaxArgs = 8;
+  static constexpr size_t kStringBytes = 48;
+
+  using EntryCallbackFn = std::function<void(avr_cycle_count_t cycle, const std::string& text)>;
+
+  explicit SimTraceLog(avr_t* avr, size_t capacity = 4096);
+  ~SimTraceLog();
+  SimTraceLog(const SimTraceLog&) = delete;
+  SimTraceLog& operator=(const SimTraceLog&) = delete;
+
+  // Route the board's log into this log. Uninstall() puts back the sink it replaced.
+  void Install();
+  void Uninstall();
+
+  void Record(const char* fmt, va_list args);
+
+  // Entries currently held, and entries overwritten since the log was created.
+  size_t Size() const;
+  uint64_t Dropped() const;
+  void Clear();
+
+  // Format the held entries, oldest first.
+  void ForEach(const EntryCallbackFn& fn) const;
+
+  // Write the held entries to path. Returns false if the file could not be written.
+  bool Dump(const char* path) const;
+
+  // Expand a file written by Dump(), oldest entry first. Returns false if the file could not be
+  // read or is not a trace dump.
+  static bool Decode(const char* path, const EntryCallbackFn& fn);
+
+ private:
+  struct Entry {
+    const char* Format;
+    avr_cycle_count_t Cycle;
+    uint8_t ArgCount;
+    uint8_t StringBytes;
+    // Integers are widened to 64 bits, doubles stored as their bits, and strings as an offset into
+    // Strings.
+    std::array<uint64_t, kMaxArgs> Args;
+    std::array<char, kStringBytes> Strings;
+  };
+
+  // The argument types of a format string, worked out once per format pointer.
+  struct Signature {
+    const char* Format{nullptr};
+    uint8_t ArgCount{0};
+    std::array<uint8_t, kMaxArgs> Kinds{};
+    // For string arguments: the precision bounding the copy, -1 for none, -2 when given by the
+    // preceding '*' argument.
+    std::array<int16_t, kMaxArgs> Precision{};
+  };
+
+  static Signature Parse(const char* fmt);
+  const Signature& GetSignature(const char* fmt);
+  static std::string Format(std::string_view format, const uint64_t* args, size_t arg_count,
+                            const char* strings);
+
+  avr_t* Avr_{nullptr};
+  std::shared_ptr<SimLogContext> Context_;
+  SimLogContext::SinkFn PreviousSink_;
+  bool Installed_{false};
+  std::array<Signature, 64> Signatures_{};
+  std::vector<Entry> Entries_;
+  size_t Next_{0};
+  size_t Size_{0};
+  uint64_t Dropped_{0};
+};
@@ -1,12 +1,38 @@
 #include "timer.hpp"
 
-#include "sim_cycle_timers.h"
+void SimTimer::Reset() {
+  Cancel();
+  if (Destroy_) {
+    Destroy_(Storage_);
+  }
+  Invoke_ = nullptr;
+  Destroy_ = nullptr;
+}
+
+void SimTimer::ScheduleAt(avr_cycle_count_t when) {
+  Wheel_->ScheduleAt(Event_, when, Trampoline, this);
+}
+
+void SimTimer::ScheduleIn(avr_cycle_count_t cycles) {
+  Wheel_->ScheduleIn(Event_, cycles, Trampoline, this);
+}
 
-avr_cycle_count_t FakeTimerCb(struct avr_t *avr, avr_cycle_count_t when, void *param) {
-  auto x = (IrqCallback *)param;
-  return (*x)(when);
+void SimTimer::ScheduleInUsec(uint32_t usec) {
+  Wheel_->ScheduleInUsec(Event_, usec, Trampoline, this);
 }
 
-void RegisterTimer(avr_t *avr, IrqCallback cb, avr_cycle_count_t when) {
-  avr_cycle_timer_register(avr, when, &FakeTimerCb, &cb);
-}
\ No newline at end of file
+avr_cycle_count_t SimTimer::Status() const {
+  return Wheel_ ? Wheel_->Status(Event_) : 0;
+}
+
+avr_cycle_count_t SimTimer::Trampoline(avr_t* avr, avr_cycle_count_t when, void* param) {
+  auto timer = static_cast<SimTimer*>(param);
+  return timer->Invoke_(timer->Storage_, when);
+}
+
+void SimTimer::UseWheel(avr_t* avr) {
+  // Looking the wheel up takes a lock, so only do it when the timer moves to another AVR.
+  if (!Wheel_ || Wheel_->Avr() != avr) {
+    Wheel_ = SimTimerWheel::Get(avr);
+  }
+}
@@ -1,11 +1,74 @@
+#pragma once
 
+#include <simavr/sim_avr.h>
 
-#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <simavr-toolbox/sim_timer_wheel.hpp>
+#include <type_traits>
+#include <utility>
+
+// A cycle timer owned by whoever holds it. The callback is stored inside the timer, so binding one
+// never allocates; it is given the cycle it was due at and returns the absolute cycle to run again
+// at, or 0. Destroying the timer cancels it, and it can be rescheduled any number of times without
+// binding it again.
+//
+// Timers run on the AVR's SimTimerWheel. A callback may destroy its own timer, provided it then
+// returns 0 without touching anything it captured.
+class SimTimer {
+ public:
+  // Room for a lambda capturing `this` and a few values.
+  static constexpr size_t kCapacity = 4 * sizeof(void*);
+
+  SimTimer() = default;
+  template <class F>
+  SimTimer(avr_t* avr, F&& fn) {
+    Bind(avr, std::forward<F>(fn));
+  }
+  ~SimTimer() { Reset(); }
+  SimTimer(const SimTimer&) = delete;
+  SimTimer& operator=(const SimTimer&) = delete;
+
+  // Replace the callback, cancelling the timer if it is pending.
+  template <class F>
+  void Bind(avr_t* avr, F&& fn) {
+    using Fn = std::decay_t<F>;
+    static_assert(sizeof(Fn) <= kCapacity, "SimTimer callback captures too much");
+    static_assert(alignof(Fn) <= alignof(std::max_align_t));
+    static_assert(std::is_invocable_r_v<avr_cycle_count_t, Fn&, avr_cycle_count_t>);
+
+    Reset();
+    UseWheel(avr);
+    new (Storage_) Fn(std::forward<F>(fn));
+    Invoke_ = [](void* storage, avr_cycle_count_t when) -> avr_cycle_count_t {
+      return (*static_cast<Fn*>(storage))(when);
+    };
+    Destroy_ = [](void* storage) { static_cast<Fn*>(storage)->~Fn(); };
+  }
+
+  // Cancel the timer and drop its callback.
+  void Reset();
 
-#include <functional>
+  // Run the callback at absolute cycle `when`, or `cycles`/`usec` from now, moving it if it is
+  // already pending.
+  void ScheduleAt(avr_cycle_count_t when);
+  void ScheduleIn(avr_cycle_count_t cycles);
+  void ScheduleInUsec(uint32_t usec);
+  void Cancel() { Event_.Cancel(); }
 
-#include "sim_avr_types.h"
+  bool IsPending() const { return Event_.IsPending(); }
+  // Like avr_cycle_timer_status(): one more than the cycles until the timer is due, 0 when it is
+  // not pending.
+  avr_cycle_count_t Status() const;
 
-using IrqCallback = std::function<avr_cycle_count_t(avr_cycle_count_t when)>;
+ private:
+  static avr_cycle_count_t Trampoline(avr_t* avr, avr_cycle_count_t when, void* param);
+  void UseWheel(avr_t* avr);
 
-void RegisterTimer(avr_t* avr, IrqCallback cb, avr_cycle_count_t when);
\ No newline at end of file
+  std::shared_ptr<SimTimerWheel> Wheel_;
+  SimTimerWheel::Event Event_;
+  avr_cycle_count_t (*Invoke_)(void* storage, avr_cycle_count_t when){nullptr};
+  void (*Destroy_)(void* storage){nullptr};
+  alignas(std::max_align_t) std::byte Storage_[kCapacity];
+};